@@ -0,0 +1,90 @@
+//Headless bot runner, for load testing and for checking the bot: plays a seeded match with the beam search bot as
+//fast as it can, feeding its key events through Tetris_Input like the game does, and reports how fast and how
+//well it played. The match is recorded, so it can be watched with replay or checked with verify
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tetris_bot.h"
+#include "tetris_replay.h"
+
+//Macro Definitions
+#define BOT_RUN_PIECES 1000U          // pieces played when --pieces is not given
+#define BOT_RUN_REPLAY "bot_last.trp"
+
+//Seconds on a monotonic clock
+static double now(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]){
+    //Optional settings: --pieces <n> --depth <n> --beam <n> --threads <n> --seed <n> --replay <file>
+    uint32_t limit = BOT_RUN_PIECES;
+    int depth = BOT_DEPTH;
+    int beam = BOT_BEAM;
+    int threads = ThreadPool_DefaultThreads();
+    uint64_t seed = 1;
+    const char *path = BOT_RUN_REPLAY;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--pieces") == 0) {
+            limit = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            depth = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--beam") == 0) {
+            beam = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            path = argv[i + 1];
+        }
+    }
+    //One thread searches on the calling thread, without a pool
+    ThreadPool pool;
+    if (threads > 1 && !ThreadPool_Start(&pool, threads)) {
+        fprintf(stderr, "Could not start worker threads\n");
+        return 1;
+    }
+    Bot bot;
+    if (!Bot_Init(&bot, threads > 1 ? &pool : NULL, (uint8_t)MIN(MAX(depth, 1), UINT8_MAX),
+                  (uint8_t)MIN(MAX(beam, 1), UINT8_MAX))) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    TetrisState state;
+    Replay replay = {0};
+    Tetris_Init(&state, seed, TETRIS_RANDOMIZER_BAG);
+    if (!Replay_Begin(&replay, &state, seed)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double start = now();
+    while (!state.game_over && state.pieces <= limit) {
+        BotInput inputs[BOT_INPUTS_MAX];
+        int count = Bot_Inputs(&bot, &state, inputs);
+        for (int i = 0; i < count; ++i) {
+            Replay_Input(&replay, &state, inputs[i].input, inputs[i].pressed, Tetris_Time(&state));
+            Tetris_Input(&state, inputs[i].input, inputs[i].pressed, Tetris_Time(&state));
+        }
+        Tetris_Step(&state, TETRIS_INPUT_NONE);
+        Replay_Step(&replay, &state);
+    }
+    double elapsed = now() - start;
+    uint32_t pieces = state.pieces - 1;
+    printf("seed %lu, depth %u, beam %u, %d thread%s: score %lu, lines %u, pieces %u%s, digest %016lx\n", seed,
+           bot.depth, bot.beam_width, threads > 1 ? pool.count : 1, threads > 1 && pool.count > 1 ? "s" : "",
+           state.score, state.total_rows_cleared, pieces, state.game_over ? ", game over" : "", Tetris_Digest(&state));
+    printf("    %.3f s, %.0f pieces/s\n", elapsed, elapsed > 0 ? pieces / elapsed : 0.0);
+    if (!Replay_End(&replay, &state) || !Replay_Save(&replay, path)) {
+        fprintf(stderr, "Could not save replay to %s\n", path);
+    }
+    Replay_Free(&replay);
+    Bot_Free(&bot);
+    if (threads > 1) {
+        ThreadPool_Stop(&pool);
+    }
+    return 0;
+}
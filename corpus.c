@@ -0,0 +1,244 @@
+//Replay corpus tool: archives replays into a corpus, re-simulates a whole corpus on every core and prints
+//statistics about the games in it, or prints a digest of every game to compare builds with
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tetris_corpus.h"
+#include "tetris_pool.h"
+#include "tetris_replay.h"
+
+//Macro Definitions
+#define CORPUS_BATCH 16U       // replays a worker claims at a time, so the shared counter is touched rarely
+#define SCORE_BUCKETS 65       // games by bit length of their score: bucket b holds scores in [2^(b-1), 2^b)
+#define DROUGHT_MAX 40U        // droughts at least this long share the last bucket
+
+//Everything gathered from the games, per worker and then summed
+typedef struct Stats {
+    uint64_t games;
+    uint64_t failed;                         // replays that did not load or stopped early
+    uint64_t ticks;
+    uint64_t score_total;
+    uint64_t score_max;
+    uint64_t scores[SCORE_BUCKETS];
+    uint64_t clears[5];                      // locks by the number of lines they cleared
+    uint64_t pieces[PIECE_COUNT];            // pieces spawned by type
+    uint64_t droughts[DROUGHT_MAX + 1];      // pieces dealt between two I pieces
+    uint32_t drought_max;                    // longest run without an I piece in any game
+} Stats;
+//One thread of the stats driver
+typedef struct Worker {
+    pthread_t thread;
+    const Corpus *corpus;
+    uint32_t *next;                          // next unclaimed replay, shared by all workers
+    Stats stats;
+} Worker;
+
+//Records a newly dealt piece; since counts the pieces dealt since the last I
+static void countPiece(Stats *stats, uint8_t type, uint32_t *since){
+    stats->pieces[type]++;
+    if (type == PIECE_I) {
+        stats->droughts[MIN(*since, DROUGHT_MAX)]++;
+        *since = 0;
+    } else {
+        ++*since;
+        stats->drought_max = MAX(stats->drought_max, *since);
+    }
+}
+//Re-simulates one replay and adds it to stats
+static void analyseReplay(Stats *stats, const uint8_t *data, size_t size){
+    TetrisState state;
+    ReplayPlayer player;
+    if (!ReplayPlayer_Open(&player, data, size, &state)) {
+        stats->failed++;
+        return;
+    }
+    uint32_t since = 0;
+    countPiece(stats, state.piece.type, &since);
+    //One event or tick at a time, so every lock is seen on its own
+    while (!ReplayPlayer_Done(&player, &state)) {
+        uint16_t events = ReplayPlayer_Advance(&player, &state);
+        if ((events & TETRIS_EVENT_LOCKED) && !(events & TETRIS_EVENT_GAME_OVER)) {
+            stats->clears[state.lines_cleared]++;
+        }
+        if (events & TETRIS_EVENT_SPAWNED) {
+            countPiece(stats, state.piece.type, &since);
+        }
+    }
+    if (player.corrupt) {
+        stats->failed++;
+        return;
+    }
+    stats->games++;
+    stats->ticks += state.ticks;
+    stats->score_total += state.score;
+    stats->score_max = MAX(stats->score_max, state.score);
+    stats->scores[state.score ? 64 - __builtin_clzll(state.score) : 0]++;
+}
+//Claims batches of replays until the corpus is used up
+static void *workerMain(void *arg){
+    Worker *worker = (Worker *)arg;
+    uint32_t count = worker->corpus->count;
+    for (;;) {
+        uint32_t first = __atomic_fetch_add(worker->next, CORPUS_BATCH, __ATOMIC_RELAXED);
+        if (first >= count) {
+            break;
+        }
+        for (uint32_t i = first; i < MIN(first + CORPUS_BATCH, count); ++i) {
+            const uint8_t *data;
+            size_t size;
+            if (Corpus_Get(worker->corpus, i, &data, &size)) {
+                analyseReplay(&worker->stats, data, size);
+            } else {
+                worker->stats.failed++;
+            }
+        }
+    }
+    return NULL;
+}
+//Adds the counts of from to into
+static void mergeStats(Stats *into, const Stats *from){
+    into->games += from->games;
+    into->failed += from->failed;
+    into->ticks += from->ticks;
+    into->score_total += from->score_total;
+    into->score_max = MAX(into->score_max, from->score_max);
+    for (int b = 0; b < SCORE_BUCKETS; ++b) {
+        into->scores[b] += from->scores[b];
+    }
+    for (int lines = 0; lines <= 4; ++lines) {
+        into->clears[lines] += from->clears[lines];
+    }
+    for (int type = 0; type < PIECE_COUNT; ++type) {
+        into->pieces[type] += from->pieces[type];
+    }
+    for (uint32_t length = 0; length <= DROUGHT_MAX; ++length) {
+        into->droughts[length] += from->droughts[length];
+    }
+    into->drought_max = MAX(into->drought_max, from->drought_max);
+}
+//Prints the summed statistics
+static void printStats(const Stats *stats, int threads, uint32_t count){
+    const char *names = "IJLOSTZ";
+    const char *clear_names[5] = {"none", "single", "double", "triple", "tetris"};
+    printf("%u replays, %lu games analysed, %lu failed, %d threads\n", count, stats->games, stats->failed, threads);
+    if (stats->games == 0) {
+        return;
+    }
+    printf("score: mean %lu, max %lu, %lu hours played\n", stats->score_total / stats->games, stats->score_max,
+           stats->ticks / TETRIS_TICK_HZ / 3600);
+    for (int b = 0; b < SCORE_BUCKETS; ++b) {
+        if (stats->scores[b]) {
+            uint64_t low = b ? 1ULL << (b - 1) : 0;
+            printf("    score %lu-%lu: %lu\n", low, b ? (low << 1) - 1 : 0, stats->scores[b]);
+        }
+    }
+    printf("line clears:");
+    for (int lines = 0; lines <= 4; ++lines) {
+        printf(" %s %lu", clear_names[lines], stats->clears[lines]);
+    }
+    printf("\npieces:");
+    for (int type = 0; type < PIECE_COUNT; ++type) {
+        printf(" %c %lu", names[type], stats->pieces[type]);
+    }
+    printf("\nI droughts (pieces between two I): longest %u\n", stats->drought_max);
+    for (uint32_t length = 0; length <= DROUGHT_MAX; ++length) {
+        if (stats->droughts[length]) {
+            printf("    %s%u: %lu\n", length == DROUGHT_MAX ? ">=" : "", length, stats->droughts[length]);
+        }
+    }
+}
+//corpus stats <corpus> [threads]: analyse every game across all cores
+static int statsCommand(const char *path, int threads){
+    Corpus corpus;
+    if (!Corpus_Open(&corpus, path)) {
+        fprintf(stderr, "%s: not a replay corpus\n", path);
+        return 1;
+    }
+    static Worker workers[POOL_MAX_THREADS];
+    uint32_t next = 0;
+    threads = MIN(MAX(threads, 1), POOL_MAX_THREADS);
+    for (int i = 0; i < threads; ++i) {
+        workers[i].corpus = &corpus;
+        workers[i].next = &next;
+        memset(&workers[i].stats, 0, sizeof(Stats));
+        if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0) {
+            fprintf(stderr, "Could not start worker thread\n");
+            threads = i;
+            break;
+        }
+    }
+    //Each worker kept its own counts, so they are only combined once everyone is done
+    Stats total = {0};
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        mergeStats(&total, &workers[i].stats);
+    }
+    if (threads == 0) {
+        workerMain(&workers[0]);
+        mergeStats(&total, &workers[0].stats);
+    }
+    printStats(&total, threads, corpus.count);
+    Corpus_Close(&corpus);
+    return 0;
+}
+//corpus digest <corpus>: one line per game with a hash of the state after every lock and at the end. Builds that
+//print the same lines simulate identically
+static int digestCommand(const char *path){
+    Corpus corpus;
+    if (!Corpus_Open(&corpus, path)) {
+        fprintf(stderr, "%s: not a replay corpus\n", path);
+        return 1;
+    }
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < corpus.count; ++i) {
+        const uint8_t *data;
+        size_t size;
+        TetrisState state;
+        ReplayPlayer player;
+        if (!Corpus_Get(&corpus, i, &data, &size) || !ReplayPlayer_Open(&player, data, size, &state)) {
+            printf("%u unreadable\n", i);
+            continue;
+        }
+        uint64_t digest = Tetris_Digest(&state);
+        while (!ReplayPlayer_Done(&player, &state)) {
+            if (ReplayPlayer_Advance(&player, &state) & TETRIS_EVENT_LOCKED) {
+                digest = (digest ^ Tetris_Digest(&state)) * 1099511628211ULL;
+            }
+        }
+        digest = (digest ^ Tetris_Digest(&state)) * 1099511628211ULL;
+        total = (total ^ digest) * 1099511628211ULL;
+        printf("%u %016lx ticks %u score %lu\n", i, digest, state.ticks, state.score);
+    }
+    printf("corpus %016lx\n", total);
+    Corpus_Close(&corpus);
+    return 0;
+}
+//corpus add <corpus> <replay>...: archive replay files
+static int addCommand(const char *path, int count, char *replays[]){
+    int failed = 0;
+    for (int i = 0; i < count; ++i) {
+        Replay replay = {0};
+        if (!Replay_Load(&replay, replays[i]) || !Corpus_Append(path, replay.data, replay.size)) {
+            fprintf(stderr, "%s: could not add to %s\n", replays[i], path);
+            failed++;
+        }
+        Replay_Free(&replay);
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+    if (argc >= 3 && strcmp(argv[1], "stats") == 0) {
+        return statsCommand(argv[2], argc >= 4 ? atoi(argv[3]) : ThreadPool_DefaultThreads());
+    }
+    if (argc >= 3 && strcmp(argv[1], "digest") == 0) {
+        return digestCommand(argv[2]);
+    }
+    if (argc >= 4 && strcmp(argv[1], "add") == 0) {
+        return addCommand(argv[2], argc - 3, argv + 3);
+    }
+    fprintf(stderr, "usage: %s stats <corpus> [threads]\n       %s digest <corpus>\n       %s add <corpus> <replay>...\n",
+            argv[0], argv[0], argv[0]);
+    return 1;
+}
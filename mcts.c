@@ -0,0 +1,96 @@
+//Headless Monte Carlo tree search runner: plays a seeded match with the MCTS player, giving every piece the same
+//time budget, and prints each position's expected value (how likely the match is to go well from there given
+//the pieces still unknown) along with the search speed, to measure how the search scales with threads
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tetris_mcts.h"
+
+//Macro Definitions
+#define MCTS_RUN_PIECES 100U   // pieces played when --pieces is not given
+#define MCTS_RUN_BUDGET 50U    // ms per piece when --budget is not given
+
+//Seconds on a monotonic clock
+static double now(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]){
+    //Optional settings: --pieces <n> --budget <ms> --threads <n> --seed <n> --randomizer uniform|bag|history --quiet 1
+    const char *randomizers[TETRIS_RANDOMIZER_COUNT] = {"uniform", "bag", "history"};
+    uint32_t limit = MCTS_RUN_PIECES;
+    uint32_t budget = MCTS_RUN_BUDGET;
+    int threads = ThreadPool_DefaultThreads();
+    uint64_t seed = 1;
+    uint8_t randomizer = TETRIS_RANDOMIZER_BAG;
+    bool quiet = false;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--pieces") == 0) {
+            limit = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--budget") == 0) {
+            budget = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = atoi(argv[i + 1]) != 0;
+        } else if (strcmp(argv[i], "--randomizer") == 0) {
+            for (uint8_t r = 0; r < TETRIS_RANDOMIZER_COUNT; ++r) {
+                if (strcmp(argv[i + 1], randomizers[r]) == 0) {
+                    randomizer = r;
+                }
+            }
+        }
+    }
+    //One thread searches on the calling thread, without a pool
+    StealPool pool;
+    if (threads > 1 && !StealPool_Start(&pool, threads)) {
+        fprintf(stderr, "Could not start worker threads\n");
+        return 1;
+    }
+    Mcts mcts;
+    if (!Mcts_Init(&mcts, threads > 1 ? &pool : NULL, seed)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    TetrisState state;
+    Tetris_Init(&state, seed, randomizer);
+    uint64_t iterations = 0;
+    double elapsed = 0;
+    while (!state.game_over && state.pieces <= limit) {
+        Move move;
+        double start = now();
+        bool found = Mcts_Search(&mcts, &state, budget, &move);
+        elapsed += now() - start;
+        iterations += mcts.iterations;
+        if (!quiet) {
+            printf("piece %4u: value %.3f, %6lu iterations, %6u nodes\n", state.pieces, mcts.value, mcts.iterations,
+                   mcts.node_count);
+        }
+        //Nowhere to go that does not end the match: let the piece lock where it is
+        if (found) {
+            Bot_Play(&state, move);
+        } else {
+            Tetris_Step(&state, TETRIS_INPUT_HARD_DROP);
+        }
+    }
+    uint32_t pieces = state.pieces - 1;
+    int workers = threads > 1 ? pool.count : 1;
+    printf("seed %lu, %u ms per piece, %d thread%s: score %lu, lines %u, pieces %u%s\n", seed, budget, workers,
+           workers > 1 ? "s" : "", state.score, state.total_rows_cleared, pieces, state.game_over ? ", game over" : "");
+    printf("    %lu iterations in %.3f s: %.0f iterations/s, %.0f per thread", iterations, elapsed,
+           elapsed > 0 ? iterations / elapsed : 0.0, elapsed > 0 ? iterations / elapsed / workers : 0.0);
+    if (threads > 1) {
+        printf(", %lu tasks stolen", StealPool_Steals(&pool));
+    }
+    printf("\n");
+    Mcts_Free(&mcts);
+    if (threads > 1) {
+        StealPool_Stop(&pool);
+    }
+    return 0;
+}
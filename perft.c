@@ -0,0 +1,99 @@
+//Move generation benchmark and regression check: counts every sequence of placements ("perft", after the chess
+//engine test) from a few fixed arenas and piece sequences, compares the counts with the golden ones below and
+//reports the speed. Any change to collision, rotation, move generation or line clearing that alters what can be
+//reached shows up as a wrong count
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tetris_moves.h"
+
+//Macro Definitions
+#define PERFT_MAX_DEPTH 7       // deepest golden count kept
+#define PERFT_DEFAULT_DEPTH 5   // depth checked when none is given, quick enough to run on every change
+
+//An arena, the pieces dealt into it and how many placement sequences each depth has
+typedef struct PerftPosition {
+    const char *name;
+    const char *pieces;                 // types dealt in order, by letter of "IJLOSTZ"; at least as many as the depth
+    uint8_t placed[ARENA_HEIGHT];
+    uint64_t counts[PERFT_MAX_DEPTH];   // golden counts at depth 1, 2, ...; 0 past the deepest one known
+} PerftPosition;
+
+//Golden counts. Only change them together with TETRIS_RULES_VERSION or a fix to move generation, and say why
+static const PerftPosition positions[] = {
+    {"empty", "TIOLJSZ", {0}, {26, 348, 2530, 69937, 1979486, 28996629}},
+    //Roof over columns 1-3 with room to tuck under it
+    {"overhang", "TSZLJIO", {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0F, 0x01, 0xE1, 0xFB},
+     {27, 422, 6090, 181729, 5331944, 80703390}},
+    //Four rows waiting for an I in the right-hand well
+    {"well", "ILJOITS", {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x3F, 0x7F, 0x7F, 0x7F, 0x7F},
+     {13, 338, 9158, 68963, 966225, 25442292}},
+    //Stack reaching the top, where many placements lock out
+    {"stack", "OZTISLJ", {0, 0, 0, 0, 0x81, 0xC3, 0xEF, 0xF7, 0xEF, 0xF7, 0xEF, 0xF7, 0xEF, 0xF7, 0xEF, 0xF7, 0xEF, 0xF7},
+     {7, 94, 1359, 5267, 17604, 69393, 417816}},
+};
+
+//Seconds on a monotonic clock
+static double now(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+//Placement sequences of depth pieces from placed, dealing pieces in order. A sequence stops where a lock ends the
+//match or the next piece cannot spawn. calls counts Moves_Generate calls
+static uint64_t perft(const uint8_t *placed, const char *pieces, int depth, uint64_t *calls){
+    Piece piece = {(uint8_t)(strchr("IJLOSTZ", pieces[0]) - "IJLOSTZ"), 0};
+    Position spawn = {(int8_t)getShape(piece)->spawn_x, -1};
+    Move moves[MOVES_MAX];
+    int count = Moves_Generate(placed, piece, spawn, moves);
+    ++*calls;
+    //The last piece only needs counting
+    if (depth == 1) {
+        return (uint64_t)count;
+    }
+    uint64_t nodes = 0;
+    for (int i = 0; i < count; ++i) {
+        if (lockOut(moves[i].piece, moves[i].position)) {
+            continue;
+        }
+        uint8_t next[ARENA_HEIGHT];
+        memcpy(next, placed, ARENA_HEIGHT);
+        addToPlaced(next, moves[i].piece, moves[i].position);
+        checkForRowClearing(next);
+        nodes += perft(next, pieces + 1, depth - 1, calls);
+    }
+    return nodes;
+}
+
+int main(int argc, char *argv[]){
+    int max_depth = argc >= 2 ? atoi(argv[1]) : PERFT_DEFAULT_DEPTH;
+    int failed = 0;
+    uint64_t total = 0;
+    uint64_t calls = 0;
+    double elapsed = 0;
+    for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); ++p) {
+        const PerftPosition *position = &positions[p];
+        for (int depth = 1; depth <= max_depth && depth <= (int)strlen(position->pieces); ++depth) {
+            uint64_t expected = depth <= PERFT_MAX_DEPTH ? position->counts[depth - 1] : 0;
+            //Without a golden count, only go as deep as asked for explicitly
+            if (expected == 0 && argc < 2) {
+                break;
+            }
+            double start = now();
+            uint64_t nodes = perft(position->placed, position->pieces, depth, &calls);
+            elapsed += now() - start;
+            total += nodes;
+            const char *verdict = expected == 0 ? "" : (nodes == expected ? " ok" : " FAILED");
+            printf("%-10s depth %d: %12lu%s", position->name, depth, nodes, verdict);
+            if (expected != 0 && nodes != expected) {
+                printf(" (expected %lu)", expected);
+                failed++;
+            }
+            printf("\n");
+        }
+    }
+    printf("%lu nodes, %lu move generations in %.3f s: %.0f nodes/s, %.0f generations/s\n", total, calls, elapsed,
+           elapsed > 0 ? total / elapsed : 0.0, elapsed > 0 ? calls / elapsed : 0.0);
+    return failed ? 1 : 0;
+}
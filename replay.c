@@ -0,0 +1,81 @@
+//Headless replay player: plays recorded matches back as fast as possible and prints how they ended. Given a tick or
+//piece to seek to, it also jumps there through the keyframes, shows the position and plays on from it, failing if
+//that does not end on the same digest as playing the whole match through
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tetris_replay.h"
+
+//Seeks the open player to tick (or to piece, if by_piece), prints the position there and plays on to the end.
+//Returns whether that ends on the digest expected from playing the match straight through
+static bool checkSeek(ReplayPlayer *player, TetrisState *state, const char *path, uint32_t target, bool by_piece,
+                      uint64_t expected){
+    const char *unit = by_piece ? "piece" : "tick";
+    bool reached = by_piece ? ReplayPlayer_SeekPiece(player, state, target) : ReplayPlayer_SeekTick(player, state, target);
+    if (!reached) {
+        fprintf(stderr, "%s: %s %u is past the end of the match\n", path, unit, target);
+        return false;
+    }
+    printf("    at %s %u: tick %u, score %lu, lines %u, pieces %u, digest %016lx\n", unit, target, state->ticks,
+           state->score, state->total_rows_cleared, state->pieces, Tetris_Digest(state));
+    while (!ReplayPlayer_Done(player, state)) {
+        ReplayPlayer_Step(player, state);
+    }
+    if (Tetris_Digest(state) != expected) {
+        fprintf(stderr, "%s: playing on from %s %u ends on digest %016lx, not %016lx\n", path, unit, target,
+                Tetris_Digest(state), expected);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]){
+    //Optional settings ahead of the replays: --seek-tick <n> or --seek-piece <n>
+    bool seek = false;
+    bool by_piece = false;
+    uint32_t target = 0;
+    int first = 1;
+    while (first + 1 < argc && (strcmp(argv[first], "--seek-tick") == 0 || strcmp(argv[first], "--seek-piece") == 0)) {
+        seek = true;
+        by_piece = strcmp(argv[first], "--seek-piece") == 0;
+        target = (uint32_t)strtoul(argv[first + 1], NULL, 10);
+        first += 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [--seek-tick <n> | --seek-piece <n>] <replay>...\n", argv[0]);
+        return 1;
+    }
+    int failed = 0;
+    for (int i = first; i < argc; ++i) {
+        Replay replay = {0};
+        TetrisState state;
+        ReplayPlayer player;
+        if (!Replay_Load(&replay, argv[i]) || !ReplayPlayer_Open(&player, replay.data, replay.size, &state)) {
+            fprintf(stderr, "%s: not a replay for rules version %u\n", argv[i], TETRIS_RULES_VERSION);
+            Replay_Free(&replay);
+            failed++;
+            continue;
+        }
+        clock_t start = clock();
+        while (!ReplayPlayer_Done(&player, &state)) {
+            ReplayPlayer_Step(&player, &state);
+        }
+        double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+        double game_time = (double)Tetris_Time(&state) / 1000;
+        printf("%s: seed %lu, score %lu, lines %u, pieces %u, %.1f s of play%s, digest %016lx\n", argv[i], player.seed,
+               state.score, state.total_rows_cleared, state.pieces, game_time, state.game_over ? ", game over" : "",
+               Tetris_Digest(&state));
+        if (elapsed > 0) {
+            printf("    played back in %.3f ms, %.0fx real time\n", elapsed * 1000, game_time / elapsed);
+        }
+        if (player.corrupt) {
+            fprintf(stderr, "%s: replay is truncated or corrupt\n", argv[i]);
+            failed++;
+        } else if (seek && !checkSeek(&player, &state, argv[i], target, by_piece, Tetris_Digest(&state))) {
+            failed++;
+        }
+        Replay_Free(&replay);
+    }
+    return failed ? 1 : 0;
+}
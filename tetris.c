@@ -6,9 +6,12 @@
 #include <assert.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
-#include <math.h>
 #include <time.h>
 #include <string.h>
+#include "tetris_core.h"
+#include "tetris_replay.h"
+#include "tetris_corpus.h"
+#include "tetris_bot.h"
 
 // Forward declarations of structs
 typedef struct Game Game;
@@ -24,22 +27,26 @@ void Game_Login(Game *game, char *username, size_t username_size);
 #define SCREEN_WIDTH_PX 1200U
 #define SCREEN_HEIGHT_PX 800U
 #define ARENA_PADDING_PX 400U
-#define ARENA_WIDTH 8U
-#define ARENA_HEIGHT 18U
-#define ARENA_SIZE 144U
-#define PIECE_WIDTH 4U
-#define PIECE_HEIGHT 4U
-#define PIECE_SIZE 16U
-#define TETROMINOS_DATA_SIZE 16U
 #define BLOCK_SIZE_PX 50U
-#define TETROMINOS_COUNT 7U
 #define PIECE_COLOR_SIZE 4U
+#define PREVIEW_SHOWN 3U            // upcoming pieces drawn beside the arena, at most TETRIS_PREVIEW
+#define PREVIEW_PADDING_PX 50U      // gap between the arena and the preview
 #define ARENA_PADDING_TOP 2U
+#define MAX_BLOCKS (ARENA_WIDTH * ARENA_HEIGHT + PIECE_WIDTH * PIECE_HEIGHT)
 #define FONT "./fonts/CC_Wild_Words_Roman.ttf"
 #define MAX_HIGH_SCORES 4
 #define HIGH_SCORE_FILE "highscores.txt"
-#define MIN(a,b) ((a) < (b) ? (a) : (b))
-#define MAX(a,b) ((a) > (b) ? (a) : (b)) 
+#define REPLAY_FILE "last_replay.trp"   // the most recent match is recorded here
+#define CORPUS_FILE "replays.tcrp"      // and every finished match is archived here
+#define TEXT_CACHE_SIZE 32
+#define TEXT_CACHE_MAX_LEN 64       // longer strings are rendered every time instead of cached
+#define GLYPH_ATLAS_CHARS "0123456789"
+#define GLYPH_ATLAS_COUNT 10
+#define GLYPH_ATLAS_FONTS 2
+#define MAX_TICKS_PER_FRAME 8       // simulation ticks a slow frame may catch up on; anything beyond is dropped
+#define PACER_SPIN_US 2000          // the last stretch before a frame deadline is busy-waited, SDL_Delay can overshoot it
+#define INPUT_QUEUE_SIZE 64         // key events read but not yet consumed by a simulation tick
+#define IDLE_REFRESH_MS 1000        // static screens are still repainted this often, in case the window contents were lost
 #define END(check, str1, str2) \
     if (check) { \
         assert(check); \
@@ -47,49 +54,188 @@ void Game_Login(Game *game, char *username, size_t username_size);
         exit(1); \
     } 
 
-enum {PIECE_I, PIECE_J, PIECE_L, PIECE_O, PIECE_S, PIECE_T, PIECE_Z, PIECE_COUNT};
 enum {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE, COLOR_GREY, COLOR_BLACK, COLOR_SIZE};
-enum {COLLIDE_NONE = 0, COLLIDE_LEFT = 1 << 0, COLLIDE_RIGHT = 1 << 1, COLLIDE_TOP = 1 << 2, COLLIDE_BOTTOM = 1 << 3, COLLIDE_PIECE = 1 << 4};
 enum {UPDATE_MAIN, UPDATE_LOSE, UPDATE_PAUSE, UPDATE_GAME_OVER};
-//Size of a Single Tetris Piece 
-typedef struct Size {
-    int w;
-    int h;
-    uint8_t start_x;
-    uint8_t start_y;
-} Size;
 //Stores info about a Player's HighScore
 typedef struct HighScore {
     char name[50];
     uint64_t score;
 } HighScore;
+//Blocks queued for drawing, grouped by colour so a whole frame is one SDL_RenderFillRects per colour
+//plus one SDL_RenderDrawRects for all the outlines and one for the ghost piece
+typedef struct BlockBatch {
+    SDL_Rect fill[COLOR_SIZE][MAX_BLOCKS];
+    int fill_count[COLOR_SIZE];
+    SDL_Rect outline[MAX_BLOCKS];
+    int outline_count;
+    SDL_Rect ghost[PIECE_WIDTH * PIECE_HEIGHT];
+    int ghost_count;
+    uint8_t ghost_color;
+} BlockBatch;
+//A rendered string kept around so labels that rarely change are not re-rasterised every frame
+typedef struct CachedText {
+    TTF_Font *font;
+    char text[TEXT_CACHE_MAX_LEN];
+    SDL_Texture *texture;
+    int w;
+    int h;
+    uint64_t last_used;                      // TextCache clock when last drawn; the oldest entry is evicted first
+} CachedText;
+//The digits of one font rendered side by side, so numbers that change every frame skip SDL_ttf entirely
+typedef struct GlyphAtlas {
+    TTF_Font *font;
+    SDL_Texture *texture;
+    int x[GLYPH_ATLAS_COUNT];                // left edge of each digit inside the texture
+    int w[GLYPH_ATLAS_COUNT];
+    int h;
+} GlyphAtlas;
+//Textures for everything drawText has drawn recently
+typedef struct TextCache {
+    CachedText entries[TEXT_CACHE_SIZE];
+    GlyphAtlas atlases[GLYPH_ATLAS_FONTS];
+    uint64_t clock;
+} TextCache;
+//One key press or release, stamped with SDL_GetPerformanceCounter() when it was read
+typedef struct InputEvent {
+    uint64_t time;
+    SDL_Keycode key;
+    bool pressed;
+} InputEvent;
+//Ring buffer of game key events waiting for the simulation, plus which game keys are down
+typedef struct InputQueue {
+    InputEvent events[INPUT_QUEUE_SIZE];
+    uint32_t head;                           // next event to consume
+    uint32_t tail;                           // where the next event is stored
+    uint8_t held;                            // TETRIS_INPUT_* whose key is currently down
+} InputQueue;
 // Represents Overall State of the Game
 typedef struct Game {
-    uint8_t level;                           // current level (affect the difficulty)
-    uint64_t score;                          // current score
+    TetrisState state;                       // The match being played (arena, falling piece, score, level)
+    InputQueue input;                        // Game key events not yet fed to the simulation
+    uint8_t das;                             // Delayed auto shift (ms) given to every new match
+    uint8_t arr;                             // Auto repeat rate (ms) given to every new match
+    uint8_t randomizer;                      // TETRIS_RANDOMIZER_* dealing the pieces of every new match
+    uint64_t seed;                           // Seed given with --seed, 0 to start every match from a fresh one
+    uint64_t match_seed;                     // Seed the current match was started with
+    Replay replay;                           // Recording of the current match
+    uint64_t perf_frequency;                 // SDL_GetPerformanceFrequency()
+    uint64_t sim_origin;                     // Performance counter value the simulation clock started at
+    uint64_t sim_ticks;                      // Ticks simulated since sim_origin; tick n is due at sim_origin + n / TETRIS_TICK_HZ seconds
+    bool score_saved;                        // Whether the finished match was already added to the high scores
+    char username[50];                       // Name of the player of the current match
     SDL_Renderer *renderer;                  // SDL renderer used to draw graphics
     SDL_Window *window;                      // SDL window 
     TTF_Font *lose_font;                     // Font used for "Game Over"
     TTF_Font *ui_font;                       // Font used for scores and instructions
-    uint8_t placed[ARENA_SIZE]; // 8 x 18 */ // A 1D array representing the arena grid (8x18 blocks). Each element indicates whether a block is occupied
     HighScore high_scores[MAX_HIGH_SCORES];  // An array to store top high scores 
     int num_high_scores;                     // The number of high scores currently stored
-    uint32_t total_rows_cleared;             // Tracks the total number of rows cleared
+    TextCache text_cache;                    // Rendered strings and digit atlases reused across frames
+    BlockBatch blocks;                       // Blocks waiting to be drawn this frame
+    SDL_Texture *board;                      // Arena background and placed blocks, redrawn only when the arena changes
+    uint16_t board_generation;               // TetrisState generation the board texture was drawn from
+    bool board_dirty;                        // Forces a redraw of the board texture (new match, lost render targets)
+    bool bot_playing;                        // Attract mode (--bot): the bot plays through the key queue, matches restart on their own
+    Bot bot;                                 // Beam search player used in attract mode
+    ThreadPool pool;                         // Worker threads the bot searches on
 } Game;
-typedef uint8_t (*Update_callback)(Game *game, uint64_t frame, SDL_KeyCode key, bool keydown);  //Defines a function pointer that updates the game based on the current frame, user input etc.
-static char current_username[50];  // Global variable to store current username
+//Keeps frames on a steady cadence measured with the performance counter
+typedef struct FramePacer {
+    uint64_t frequency;                      // performance counter ticks per second
+    uint32_t fps;                            // target frames per second
+    uint64_t origin;                         // counter value the current schedule started at
+    uint64_t frame;                          // frames presented since origin; frame n is due at origin + n * frequency / fps
+    uint64_t last_present;                   // counter value of the previous present, 0 when the next interval should not be measured
+    uint64_t samples;                        // frame intervals measured
+    uint64_t total_jitter;                   // sum of |interval - ideal interval| in counter ticks
+    uint64_t max_jitter;                     // worst |interval - ideal interval| in counter ticks
+} FramePacer;
+typedef uint8_t (*Update_callback)(Game *game, uint32_t ticks, SDL_KeyCode key, bool keydown);  //Defines a function pointer that updates the game based on the simulation ticks due this frame, user input etc.
+//Rasterises text into a new texture
+SDL_Texture *renderText(SDL_Renderer *renderer, TTF_Font *font, const char *text, int *w, int *h){
+    TTF_SizeText(font, text, w, h);
+    SDL_Color font_color = {.r = 255, .g = 255, .b = 255, .a = 255};
+    SDL_Surface *surface = TTF_RenderText_Solid(font, text, font_color);
+    END(surface == NULL, "Could not create surface\n", SDL_GetError());
+    //Convert thr suraface into a texture (This step is important because SDL2 renders textures, not surfaces)
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    END(texture == NULL, "Could not create texture", SDL_GetError());
+    SDL_FreeSurface(surface);
+    return texture;
+}
+//Finds the cached texture for text, rendering it into the least recently used slot on a miss
+CachedText *getCachedText(Game *game, TTF_Font *font, const char *text){
+    TextCache *cache = &game->text_cache;
+    CachedText *oldest = &cache->entries[0];
+    cache->clock++;
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        CachedText *entry = &cache->entries[i];
+        if (entry->texture != NULL && entry->font == font && strcmp(entry->text, text) == 0) {
+            entry->last_used = cache->clock;
+            return entry;
+        }
+        if (entry->last_used < oldest->last_used) {
+            oldest = entry;
+        }
+    }
+    if (oldest->texture != NULL) {
+        SDL_DestroyTexture(oldest->texture);
+    }
+    oldest->font = font;
+    strcpy(oldest->text, text);
+    oldest->texture = renderText(game->renderer, font, text, &oldest->w, &oldest->h);
+    oldest->last_used = cache->clock;
+    return oldest;
+}
+//Finds the digit atlas for a font, building it the first time the font is used
+GlyphAtlas *getGlyphAtlas(Game *game, TTF_Font *font){
+    GlyphAtlas *atlas = NULL;
+    for (int i = 0; i < GLYPH_ATLAS_FONTS; i++) {
+        atlas = &game->text_cache.atlases[i];
+        if (atlas->font == font || atlas->font == NULL) {
+            break;
+        }
+    }
+    if (atlas->font == font) {
+        return atlas;
+    }
+    END(atlas->font != NULL, "Too many fonts for the glyph atlas", "");
+    int w = 0;
+    atlas->font = font;
+    atlas->texture = renderText(game->renderer, font, GLYPH_ATLAS_CHARS, &w, &atlas->h);
+    //The width of each prefix gives where every digit starts, kerning included
+    char prefix[GLYPH_ATLAS_COUNT + 1] = GLYPH_ATLAS_CHARS;
+    for (int i = 0; i < GLYPH_ATLAS_COUNT; i++) {
+        prefix[i] = '\0';
+        atlas->x[i] = 0;
+        if (i > 0) {
+            TTF_SizeText(font, prefix, &atlas->x[i], NULL);
+        }
+        prefix[i] = GLYPH_ATLAS_CHARS[i];
+    }
+    for (int i = 0; i < GLYPH_ATLAS_COUNT; i++) {
+        int next = i + 1 < GLYPH_ATLAS_COUNT ? atlas->x[i + 1] : w;
+        atlas->w[i] = next - atlas->x[i];
+    }
+    return atlas;
+}
 //Function based on rendering text on screen
-void drawText(SDL_Renderer *renderer, TTF_Font *font, const char *text, SDL_Point point){
+void drawText(Game *game, TTF_Font *font, const char *text, SDL_Point point){
     if (text == NULL || strlen(text) == 0) {
         fprintf(stderr, "Text is empty");
         return;
     }
+    SDL_Texture *texture;
     int w = 0;
     int h = 0;
-    TTF_SizeText(font, text, &w, &h);
-    SDL_Color font_color = {.r = 255, .g = 255, .b = 255, .a = 255};
-    SDL_Surface *surface = TTF_RenderText_Solid(font, text, font_color);
-    END(surface == NULL, "Could not create surface\n", SDL_GetError());
+    bool cached = strlen(text) < TEXT_CACHE_MAX_LEN;
+    if (cached) {
+        CachedText *entry = getCachedText(game, font, text);
+        texture = entry->texture;
+        w = entry->w;
+        h = entry->h;
+    } else {
+        texture = renderText(game->renderer, font, text, &w, &h);
+    }
     //Position the text on the screen
     SDL_Rect rect = {
         .x = point.x - (w / 2),
@@ -97,13 +243,53 @@ void drawText(SDL_Renderer *renderer, TTF_Font *font, const char *text, SDL_Poin
         .w = w,
         .h = h,
     };
-    //Convert thr suraface into a texture (This step is important because SDL2 renders textures, not surfaces)
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-    END(texture == NULL, "Could not create texture", SDL_GetError());
     //Renders the texture onto screen
-    SDL_RenderCopy(renderer, texture, NULL, &rect);
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    SDL_RenderCopy(game->renderer, texture, NULL, &rect);
+    if (!cached) {
+        SDL_DestroyTexture(texture);
+    }
+}
+//Renders a label followed by a number; the label comes from the text cache and the digits from the glyph atlas
+void drawNumber(Game *game, TTF_Font *font, const char *label, uint64_t value, SDL_Point point){
+    CachedText *prefix = getCachedText(game, font, label);
+    GlyphAtlas *atlas = getGlyphAtlas(game, font);
+    char digits[24];
+    int count = sprintf(digits, "%lu", value);
+    int w = prefix->w;
+    for (int i = 0; i < count; i++) {
+        w += atlas->w[digits[i] - '0'];
+    }
+    int h = MAX(prefix->h, atlas->h);
+    SDL_Rect rect = {
+        .x = point.x - (w / 2),
+        .y = point.y - (h / 2),
+        .w = prefix->w,
+        .h = prefix->h,
+    };
+    SDL_RenderCopy(game->renderer, prefix->texture, NULL, &rect);
+    rect.x += prefix->w;
+    rect.h = atlas->h;
+    for (int i = 0; i < count; i++) {
+        int digit = digits[i] - '0';
+        SDL_Rect glyph = {.x = atlas->x[digit], .y = 0, .w = atlas->w[digit], .h = atlas->h};
+        rect.w = glyph.w;
+        SDL_RenderCopy(game->renderer, atlas->texture, &glyph, &rect);
+        rect.x += glyph.w;
+    }
+}
+//Releases every texture held by the text cache
+void clearTextCache(TextCache *cache){
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (cache->entries[i].texture != NULL) {
+            SDL_DestroyTexture(cache->entries[i].texture);
+        }
+    }
+    for (int i = 0; i < GLYPH_ATLAS_FONTS; i++) {
+        if (cache->atlases[i].texture != NULL) {
+            SDL_DestroyTexture(cache->atlases[i].texture);
+        }
+    }
+    memset(cache, 0, sizeof(TextCache));
 }
 //Reads the high scores stored in a file
 void load_high_scores(Game *game) {
@@ -174,7 +360,7 @@ void draw_high_scores(Game *game, SDL_Rect game_over_box) {
             .x = SCREEN_WIDTH_PX / 2,
             .y = container.y + 30
         };
-        drawText(game->renderer, game->lose_font, "HIGH SCORES", title_pos);
+        drawText(game, game->lose_font, "HIGH SCORES", title_pos);
     
         int start_y = title_pos.y + 100;
         int spacing = 60;
@@ -185,24 +371,24 @@ void draw_high_scores(Game *game, SDL_Rect game_over_box) {
                 .y = start_y + (i * spacing)
             };
             sprintf(score_text, "#%d  %-20s %8lu", i + 1, game->high_scores[i].name, game->high_scores[i].score);
-            drawText(game->renderer, game->ui_font, score_text, score_pos);
+            drawText(game, game->ui_font, score_text, score_pos);
         }
         if (game->num_high_scores == 0) {
             SDL_Point no_scores_pos = {
                 .x = SCREEN_WIDTH_PX / 2,
                 .y = start_y + spacing
             };
-            drawText(game->renderer, game->ui_font, "No high scores", no_scores_pos);
+            drawText(game, game->ui_font, "No high scores", no_scores_pos);
         }
         SDL_Point instructions_pos = {
                 .x = SCREEN_WIDTH_PX / 2,
                 .y = container.y + container.h - 40
             };
-            drawText(game->renderer, game->ui_font, "Press SPACE to continue", instructions_pos);
+            drawText(game, game->ui_font, "Press SPACE to continue", instructions_pos);
     }
     
 //rendering the pause menu
-static uint8_t updatePause(Game *game, uint64_t frame, SDL_KeyCode key, bool keydown){
+static uint8_t updatePause(Game *game, uint32_t ticks, SDL_KeyCode key, bool keydown){
     SDL_Point title_point = {
         .x = SCREEN_WIDTH_PX / 2,
         .y = SCREEN_HEIGHT_PX / 2 - 160 
@@ -246,10 +432,10 @@ static uint8_t updatePause(Game *game, uint64_t frame, SDL_KeyCode key, bool key
     SDL_RenderFillRect(game->renderer, &glow);
     setColor(game->renderer, COLOR_BLACK);
     SDL_RenderFillRect(game->renderer, &pause_container);
-    drawText(game->renderer, game->lose_font, "PAUSED", title_point);
-    drawText(game->renderer, game->ui_font, "Press R to Resume", resume_point);
-    drawText(game->renderer, game->ui_font, "Press M for Main Menu", menu_point);
-    drawText(game->renderer, game->ui_font, "Press E to Exit Game", exit_point);
+    drawText(game, game->lose_font, "PAUSED", title_point);
+    drawText(game, game->ui_font, "Press R to Resume", resume_point);
+    drawText(game, game->ui_font, "Press M for Main Menu", menu_point);
+    drawText(game, game->ui_font, "Press E to Exit Game", exit_point);
     if (keydown) {
         switch (key) {
             case SDLK_r: // Resume
@@ -263,219 +449,65 @@ static uint8_t updatePause(Game *game, uint64_t frame, SDL_KeyCode key, bool key
     }
     return UPDATE_PAUSE;//if no key is pressed the game state is kept same
 }
-//calculate score based on current level
-int findPoints(uint8_t level, uint8_t lines){
-    switch (lines) {
-        case 1: return 40 * (level + 1);
-        case 2: return 100 * (level + 1);
-        case 3: return 300 * (level + 1);
-        case 4: return 1200 * (level + 1);
-    }
-    return 0;
+//Screen rectangle of arena cell (x, y), in pixels relative to the arena's top-left corner
+static SDL_Rect blockRect(int x, int y){
+    SDL_Rect rect = {
+        .x = (int)(x * (int)BLOCK_SIZE_PX),
+        .y = (int)(y - ARENA_PADDING_TOP) * (int)BLOCK_SIZE_PX,
+        .w = BLOCK_SIZE_PX, 
+        .h = BLOCK_SIZE_PX
+    };
+    return rect;
 }
-//marking a specific position in game as occupied
-void addToArena(uint8_t *placed, uint8_t i){
-    if (i < ARENA_SIZE && i >= 0){
-        placed[i] = 1;
-        }
-}
-//calculates the index in the placed array coressponding to a given 2D position
-uint8_t getPlacedPosition(SDL_Point pos){
-    uint8_t i = pos.y * ARENA_WIDTH + pos.x;
-    return i < ARENA_SIZE ? i : ARENA_SIZE - 1;
-}
-//converting a 1D index to its coressponding 2D position
-void getXY(uint8_t i, int *x, int *y) {
-    *x = i % PIECE_WIDTH;
-    *y = floor((float)i / PIECE_HEIGHT);
-}
-//calculates dimensions of a Tetromino piece
-void getPieceSize(uint8_t *piece, Size *size){
-    memset(size, 0, sizeof(Size));
-
-    bool foundStartx = false;
-    bool foundStarty = false;
-    //calclulate the width and starting X-offset 
-    for (uint8_t x = 0; x < PIECE_WIDTH; ++x) {
-        for (uint8_t y = 0; y < PIECE_HEIGHT; ++y) {
-            uint8_t i = y * PIECE_WIDTH + x;
-            if (piece[i]) {
-                if (!foundStartx) {
-                    size->start_x = x;
-                    foundStartx = true;
-                }
-                size->w++;
-                break;
-            }
-        }
-    }
-    //calclulates the height and starting Y-offset
-    for (uint8_t y = 0; y < PIECE_HEIGHT; ++y) {
-        for (uint8_t x = 0; x < PIECE_WIDTH; ++x) {
-            uint8_t i = y * PIECE_WIDTH + x;
-            if (piece[i]) {
-                if (!foundStarty) {
-                    size->start_y = y;
-                    foundStarty = true;
-                }
-                size->h++;
-                break;
-            }
-        }
-    }
+//Queues one block at arena cell (x, y)
+void addBlock(BlockBatch *batch, int x, int y, uint8_t color){
+    SDL_Rect rect = blockRect(x, y);
+    batch->fill[color][batch->fill_count[color]++] = rect;
+    batch->outline[batch->outline_count++] = rect;
 }
-//Rotating a Tetromino piece 90 degrees clockwise
-void rotatePiece(uint8_t *piece, uint8_t *rotated){
-    memset(rotated, 0, sizeof(uint8_t) * PIECE_SIZE);
-    uint8_t i = 0;
-    // 90 degrees
-    for (int x = 0; x < PIECE_HEIGHT; x++) {
-        for (int y = PIECE_WIDTH - 1; y >= 0; y--) {
-            uint8_t j = y * PIECE_WIDTH + x;
-            rotated[i] = piece[j];
-            i++;
-        }
+//Submits every queued block and empties the batch. The ghost goes first so the falling piece covers it
+void flushBlocks(SDL_Renderer *renderer, BlockBatch *batch){
+    if (batch->ghost_count > 0) {
+        setColor(renderer, batch->ghost_color);
+        SDL_RenderDrawRects(renderer, batch->ghost, batch->ghost_count);
+        batch->ghost_count = 0;
     }
-}
-//Rendering Tetromino piece on screen
-void drawTetromino(SDL_Renderer *renderer, uint8_t piece[PIECE_SIZE], SDL_Point position, uint8_t color){
-    for (int i = 0; i < TETROMINOS_DATA_SIZE; ++i) {
-        if (!piece[i]) {
-                continue;
-        }
-        int x, y; 
-        getXY(i, &x, &y);
-        SDL_Rect rect = {
-            .x = (int)((x + position.x) * (int)BLOCK_SIZE_PX) + (int)ARENA_PADDING_PX,
-            .y = (int)(y + position.y - ARENA_PADDING_TOP) * (int)BLOCK_SIZE_PX,
-            .w = BLOCK_SIZE_PX, 
-            .h = BLOCK_SIZE_PX
-        };
+    for (uint8_t color = 0; color < COLOR_SIZE; ++color) {
+        if (batch->fill_count[color] == 0) {
+            continue;
+        }
         setColor(renderer, color);
-        SDL_RenderFillRect(renderer, &rect);
+        SDL_RenderFillRects(renderer, batch->fill[color], batch->fill_count[color]);
+        batch->fill_count[color] = 0;
+    }
+    if (batch->outline_count > 0) {
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderDrawRect(renderer, &rect);
-    }
-}
-//Clearing a completed row and shifting the above one below
-void clearRow(uint8_t *placed, uint8_t c){
-    uint8_t temp[ARENA_SIZE];
-    memset(temp, 0, sizeof(uint8_t) * ARENA_SIZE);
-    memcpy(temp, placed, sizeof(uint8_t) * ARENA_SIZE);
-    for (int y = c; y > 0; --y) {
-        for (uint8_t x = 0; x < ARENA_WIDTH; ++x) {
-            uint8_t i = y * ARENA_WIDTH + x;
-            if (i >= 0) {
-                temp[i] = placed[i - ARENA_WIDTH];
-                }
-        }
+        SDL_RenderDrawRects(renderer, batch->outline, batch->outline_count);
+        batch->outline_count = 0;
     }
-    memcpy(placed, temp, sizeof(uint8_t) * ARENA_SIZE);
 }
-//detecting and clearing fully occupied rows in arena 
-uint8_t checkForRowClearing(uint8_t *placed){
-    uint8_t row_count = 0;
-    uint8_t lines = 0;
-    for (uint8_t y = 0; y < ARENA_HEIGHT; ++y) {
-        for (uint8_t x = 0; x < ARENA_WIDTH; ++x) {
-            if (x == 0) {
-                row_count = 0;
-                }
-            uint8_t i = y * ARENA_WIDTH + x;
-            if (placed[i]) {
-                row_count++;
-                }
-            if ((x == ARENA_WIDTH - 1) && (row_count == ARENA_WIDTH)) {
-                clearRow(placed, y);
-                lines++;
+//Rendering Tetromino piece on screen
+void drawTetromino(BlockBatch *batch, Piece piece, Position position, uint8_t color){
+    const Shape *shape = getShape(piece);
+    for (int y = 0; y < PIECE_HEIGHT; ++y) {
+        for (int x = 0; x < PIECE_WIDTH; ++x) {
+            if (shape->rows[y] & (1U << x)) {
+                addBlock(batch, x + position.x, y + position.y, color);
             }
         }
     }
-    return lines;
-}
-//Adding a Tetromino piece to placed array
-void addToPlaced(uint8_t *placed, uint8_t *piece, SDL_Point position){
-    uint8_t pos = getPlacedPosition(position);
-    for (uint8_t i = 0; i < TETROMINOS_DATA_SIZE; ++i) {
-        int x, y; 
-        getXY(i, &x, &y);
-        uint8_t piece_i = y * PIECE_WIDTH + x;
-        uint8_t placed_i = y * ARENA_WIDTH + x;
-        if (piece[piece_i]) {
-                addToArena(placed, pos + placed_i);
-        }
-    }
 }
-//Detecting collision between pieces and boundary
-uint8_t collisionCheck(uint8_t *placed, uint8_t *piece, SDL_Point position){
-    Size size; 
-    getPieceSize(piece, &size);
-    uint8_t placed_pos = getPlacedPosition(position);
-    uint8_t collide = COLLIDE_NONE;
-    if (position.x < -size.start_x) {
-        collide |= COLLIDE_LEFT;
-        }
-    if (position.x + size.start_x + size.w > ARENA_WIDTH){
-        collide |= COLLIDE_RIGHT;
-        }
-    if (position.y + size.start_y + size.h > ARENA_HEIGHT){
-        collide |= COLLIDE_BOTTOM;
-        }
-    for (uint8_t y = 0; y < PIECE_HEIGHT; ++y) {
-        for (uint8_t x = 0; x < PIECE_WIDTH; ++x) {
-            uint8_t piece_i = y * PIECE_WIDTH + x;
-            uint8_t placed_i = placed_pos + (y * ARENA_WIDTH + x);
-            if (piece[piece_i] && placed[placed_i]) {
-                collide |= COLLIDE_PIECE;
-                return collide;
+//Outlines where piece would land, drawn in its own colour
+void drawGhost(BlockBatch *batch, Piece piece, Position position, uint8_t color){
+    const Shape *shape = getShape(piece);
+    for (int y = 0; y < PIECE_HEIGHT; ++y) {
+        for (int x = 0; x < PIECE_WIDTH; ++x) {
+            if (shape->rows[y] & (1U << x)) {
+                batch->ghost[batch->ghost_count++] = blockRect(x + position.x, y + position.y);
             }
         }
     }
-    return collide;
-}
-//Selecting Random Tetromino and assign them color
-void pickPiece(uint8_t *piece, uint8_t *color){
-    const uint8_t tetrominos[TETROMINOS_COUNT]
-                                   [PIECE_SIZE] = {
-        [PIECE_I] = {0,0,0,0,
-                     1,1,1,1,
-                     0,0,0,0,
-                     0,0,0,0},
-
-        [PIECE_J] = {0,0,0,0,
-                     1,0,0,0,
-                     1,1,1,0,
-                     0,0,0,0},
-
-        [PIECE_L] = {0,0,0,0,
-                     0,0,1,0,
-                     1,1,1,0,
-                     0,0,0,0},
-
-        [PIECE_O] = {0,0,0,0,
-                     0,1,1,0,
-                     0,1,1,0,
-                     0,0,0,0},
-
-        [PIECE_S] = {0,0,0,0,
-                     0,1,1,0,
-                     1,1,0,0,
-                     0,0,0,0},
-
-        [PIECE_T] = {0,0,0,0,
-                     0,1,0,0,
-                     1,1,1,0,
-                     0,0,0,0},
-
-        [PIECE_Z] = {0,0,0,0,
-                     1,1,0,0,
-                     0,1,1,0,
-                     0,0,0,0},
-    };
-    const uint8_t piece_colors[PIECE_COLOR_SIZE] = {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE};
-    uint8_t id = (float)((float)rand() / (float)RAND_MAX) * PIECE_COUNT;
-    memcpy(piece, &tetrominos[id], sizeof(uint8_t) * PIECE_SIZE);
-    *color = piece_colors[((*color) + 1) % PIECE_COLOR_SIZE];
+    batch->ghost_color = color;
 }
 //Initailize the game 
 void Game_Init(Game *game){
@@ -493,37 +525,31 @@ void Game_Init(Game *game){
     END(game->window == NULL, "Could not create window", SDL_GetError());
     game->renderer = SDL_CreateRenderer(game->window, 0, SDL_RENDERER_SOFTWARE);
     END(game->renderer == NULL, "Could not create renderer", SDL_GetError());
+    game->board = SDL_CreateTexture(game->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, ARENA_WIDTH_PX, ARENA_HEIGHT_PX);
+    END(game->board == NULL, "Could not create board texture", SDL_GetError());
+    game->board_dirty = true;
+    game->perf_frequency = SDL_GetPerformanceFrequency();
+    game->das = DAS_MS;
+    game->arr = ARR_MS;
+    game->randomizer = TETRIS_RANDOMIZER_BAG;
     load_high_scores(game);
-    game->total_rows_cleared = 0;
+    Tetris_Init(&game->state, 0, game->randomizer);
 }
 //Rendering the placed blocks
-void drawPlaced(uint8_t *placed, SDL_Renderer *renderer) {
-    for (int x = 0; x < ARENA_WIDTH; ++x) {
-        for (int y = 0; y < ARENA_HEIGHT; ++y) {
-            uint8_t i = y * ARENA_WIDTH + x;
-            if (!placed[i]) {
-                continue;
+void drawPlaced(BlockBatch *batch, const uint8_t *placed) {
+    for (int y = 0; y < ARENA_HEIGHT; ++y) {
+        for (int x = 0; x < ARENA_WIDTH; ++x) {
+            if (placed[y] & (1U << x)) {
+                addBlock(batch, x, y, COLOR_GREY);
             }
-            SDL_Rect rect = {
-                .x = (int)(x * (int)BLOCK_SIZE_PX) + (int)ARENA_PADDING_PX,
-                .y = (int)(y - ARENA_PADDING_TOP) * (int)BLOCK_SIZE_PX,
-                .w = BLOCK_SIZE_PX, 
-                .h = BLOCK_SIZE_PX
-            };
-            setColor(renderer, COLOR_GREY);
-            SDL_RenderFillRect(renderer, &rect);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderDrawRect(renderer, &rect);
         }
     }
 }
 
-static uint8_t updateLose(Game *game, uint64_t frame, SDL_KeyCode key, bool keydown) {
-    static bool first_update = true;
-
-    if (first_update) {
-        update_high_scores(game, current_username, game->score);
-        first_update = false;
+static uint8_t updateLose(Game *game, uint32_t ticks, SDL_KeyCode key, bool keydown) {
+    if (!game->score_saved) {
+        update_high_scores(game, game->username, game->state.score);
+        game->score_saved = true;
     }
 
     // Draw game over screen
@@ -563,23 +589,20 @@ static uint8_t updateLose(Game *game, uint64_t frame, SDL_KeyCode key, bool keyd
         .x = SCREEN_WIDTH_PX / 2,
         .y = container.y + 50
     };
-    drawText(game->renderer, game->lose_font, "GAME OVER!!", title_pos);
+    drawText(game, game->lose_font, "GAME OVER!!", title_pos);
 
     // Draw final score
-    char score_text[255];
-    sprintf(score_text, "Final Score: %lu", game->score);
     SDL_Point score_pos = {
         .x = SCREEN_WIDTH_PX / 2,
         .y = container.y + 100
     };
-    drawText(game->renderer, game->ui_font, score_text, score_pos);
+    drawNumber(game, game->ui_font, "Final Score: ", game->state.score, score_pos);
 
     draw_high_scores(game, container);
 
     if (keydown) {
         switch (key) {
             case SDLK_SPACE:
-                first_update = true;
                 return UPDATE_GAME_OVER;
             case SDLK_ESCAPE:
                 Game_Quit(game);
@@ -589,146 +612,289 @@ static uint8_t updateLose(Game *game, uint64_t frame, SDL_KeyCode key, bool keyd
     return UPDATE_LOSE;
 }
 //Responsible for resetting the game
-static uint8_t updateGameOver(Game *game, uint64_t frame, SDL_KeyCode key, bool keydown){
-    game->score = 0;
-    game->level = 0;
-    memset(game->placed, 0, sizeof(uint8_t) * ARENA_SIZE);
+static uint8_t updateGameOver(Game *game, uint32_t ticks, SDL_KeyCode key, bool keydown){
     char username[50];
     Game_Login(game, username, sizeof(username));
     return UPDATE_MAIN;
 }
-//Core game Loop
-static uint8_t updateMain(Game *game, uint64_t frame, SDL_KeyCode key, bool keydown) {
-    static SDL_Point piece_position = {.x = 0, .y = -1};
-    static uint8_t fall_speed = 30;
-    static uint8_t current_piece[PIECE_SIZE];
-    static uint8_t color = COLOR_RED;
-    static bool init = true;
-
-    if (init) {
-        srand(time(NULL));
-        memset(&game->placed, 0, sizeof(uint8_t) * ARENA_SIZE);
-        pickPiece(current_piece, &color);
-        init = false;
+//Maps a key to the action it controls in the game
+uint8_t keyToInput(SDL_Keycode key){
+    switch (key) {
+        case SDLK_a: return TETRIS_INPUT_LEFT;
+        case SDLK_d: return TETRIS_INPUT_RIGHT;
+        case SDLK_r: return TETRIS_INPUT_ROTATE;
+        case SDLK_s: return TETRIS_INPUT_SOFT_DROP;
+        case SDLK_w: return TETRIS_INPUT_HARD_DROP;
     }
-
-    if (piece_position.y == -1) {
-        Size size;
-        getPieceSize(current_piece, &size);
-        piece_position.x = (ARENA_WIDTH / 2) - (size.w / 2);
+    return TETRIS_INPUT_NONE;
+}
+//Maps an action back to the key that controls it, so the bot can press keys like a player
+SDL_Keycode inputToKey(uint8_t input){
+    switch (input) {
+        case TETRIS_INPUT_LEFT: return SDLK_a;
+        case TETRIS_INPUT_RIGHT: return SDLK_d;
+        case TETRIS_INPUT_ROTATE: return SDLK_r;
+        case TETRIS_INPUT_SOFT_DROP: return SDLK_s;
+        case TETRIS_INPUT_HARD_DROP: return SDLK_w;
     }
-
-    drawTetromino(game->renderer, current_piece, piece_position, color);
-
-    if (!keydown) {
-        fall_speed = 30;
+    return SDLK_UNKNOWN;
+}
+//Queues a game key event; repeats of a key that is already down and releases of one that is not are ignored
+void InputQueue_Push(InputQueue *queue, SDL_Keycode key, bool pressed, uint64_t time){
+    uint8_t input = keyToInput(key);
+    if (input == TETRIS_INPUT_NONE || ((queue->held & input) != 0) == pressed) {
+        return;
+    }
+    if (queue->tail - queue->head == INPUT_QUEUE_SIZE) {
+        fprintf(stderr, "Input queue full, dropping key event\n");
+        return;
+    }
+    InputEvent *event = &queue->events[queue->tail % INPUT_QUEUE_SIZE];
+    event->time = time;
+    event->key = key;
+    event->pressed = pressed;
+    queue->tail++;
+    queue->held = pressed ? (queue->held | input) : (queue->held & ~input);
+}
+//Takes the oldest event if it happened no later than time
+bool InputQueue_Pop(InputQueue *queue, uint64_t time, InputEvent *event){
+    if (queue->head == queue->tail || queue->events[queue->head % INPUT_QUEUE_SIZE].time > time) {
+        return false;
     }
+    *event = queue->events[queue->head % INPUT_QUEUE_SIZE];
+    queue->head++;
+    return true;
+}
+//Forgets queued events and held keys, e.g. when play resumes after a menu
+void InputQueue_Clear(InputQueue *queue){
+    memset(queue, 0, sizeof(InputQueue));
+}
+//Performance counter value at which simulation tick n is due
+uint64_t tickDue(const Game *game, uint64_t tick){
+    return game->sim_origin + tick * game->perf_frequency / TETRIS_TICK_HZ;
+}
+//Restarts the simulation clock at the current time, dropping any ticks that were due
+void resetSimClock(Game *game){
+    game->sim_origin = SDL_GetPerformanceCounter();
+    game->sim_ticks = 0;
+}
+//Redraws the arena background and placed blocks into the board texture if the arena changed since last time
+void updateBoard(Game *game){
+    const TetrisState *state = &game->state;
+    if (!game->board_dirty && game->board_generation == state->generation) {
+        return;
+    }
+    SDL_SetRenderTarget(game->renderer, game->board);
+    setColor(game->renderer, COLOR_BLACK);
+    SDL_RenderClear(game->renderer);
+    drawPlaced(&game->blocks, state->placed);
+    flushBlocks(game->renderer, &game->blocks);
+    SDL_SetRenderTarget(game->renderer, NULL);
+    game->board_generation = state->generation;
+    game->board_dirty = false;
+}
+//Closes the recording of the current match, if one is running, writes it to REPLAY_FILE and archives it.
+//Attract mode matches are not the player's, so they neither replace the last replay nor fill up the corpus
+static void saveReplay(Game *game){
+    if (game->bot_playing || game->replay.size == 0 || game->replay.ended) {
+        return;
+    }
+    if (!Replay_End(&game->replay, &game->state) || !Replay_Save(&game->replay, REPLAY_FILE)) {
+        fprintf(stderr, "Could not save replay to %s\n", REPLAY_FILE);
+    }
+    if (game->replay.ended && !Corpus_Append(CORPUS_FILE, game->replay.data, game->replay.size)) {
+        fprintf(stderr, "Could not add replay to %s\n", CORPUS_FILE);
+    }
+}
+//Records the match that was being played and sets up a new one
+static void startMatch(Game *game){
+    saveReplay(game);
+    game->match_seed = game->seed ? game->seed : (uint64_t)time(NULL) ^ SDL_GetPerformanceCounter();
+    Tetris_Init(&game->state, game->match_seed, game->randomizer);
+    game->state.das = game->das;
+    game->state.arr = game->arr;
+    END(!Replay_Begin(&game->replay, &game->state, game->match_seed), "Could not start replay", "out of memory");
+    InputQueue_Clear(&game->input);
+    game->bot.has_target = false;
+    game->score_saved = false;
+    game->board_dirty = true;
+}
+//Draws the next pieces in a column beside the arena, each in the colour it will spawn with
+static void drawPreview(Game *game){
+    const uint8_t piece_colors[PIECE_COLOR_SIZE] = {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE};
+    const TetrisState *state = &game->state;
+    SDL_Rect preview_rect = {
+        .x = ARENA_PADDING_PX + ARENA_WIDTH_PX + PREVIEW_PADDING_PX,
+        .y = 0,
+        .w = PIECE_WIDTH * BLOCK_SIZE_PX,
+        .h = ARENA_HEIGHT_PX
+    };
+    SDL_RenderSetViewport(game->renderer, &preview_rect);
+    for (uint8_t i = 0; i < PREVIEW_SHOWN; ++i) {
+        Piece piece = {.type = state->next[i], .rotation = 0};
+        const Shape *shape = getShape(piece);
+        //Every piece gets a slot of PIECE_HEIGHT - 1 rows, starting just below the top padding
+        Position position = {
+            .x = (int8_t)-shape->start_x,
+            .y = (int8_t)(ARENA_PADDING_TOP + 1 + i * (PIECE_HEIGHT - 1) - shape->start_y)
+        };
+        drawTetromino(&game->blocks, piece, position, piece_colors[(state->pieces + 1 + i) % PIECE_COLOR_SIZE]);
+    }
+    flushBlocks(game->renderer, &game->blocks);
+}
+//Core game Loop
+static uint8_t updateMain(Game *game, uint32_t ticks, SDL_KeyCode key, bool keydown) {
+    const uint8_t piece_colors[PIECE_COLOR_SIZE] = {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE};
+    TetrisState *state = &game->state;
+    uint16_t events = TETRIS_EVENT_NONE;
 
-    switch (key) {
-        case SDLK_d: {
-            SDL_Point check = {.x = piece_position.x + 1, .y = piece_position.y};
-            if (!collisionCheck(game->placed, current_piece, check)) {
-                piece_position.x++;
-            }
-            break;
-        }
-        case SDLK_a: {
-            SDL_Point check = {.x = piece_position.x - 1, .y = piece_position.y};
-            if (!collisionCheck(game->placed, current_piece, check)) {
-                piece_position.x--;
-            }
-            break;
-        }
-        case SDLK_s: {
-            fall_speed = 1;
-            break;
-        }
-        case SDLK_r: {
-            uint8_t rotated[PIECE_SIZE];
-            SDL_Point check;
-            rotatePiece(current_piece, rotated);
-            uint8_t collide = collisionCheck(game->placed, rotated, piece_position);
-            memcpy(&check, &piece_position, sizeof(SDL_Point));
-            if (collide == COLLIDE_LEFT) {
-                while (collide == COLLIDE_LEFT) {
-                    check.x++;
-                    collide = collisionCheck(game->placed, rotated, check);
-                }
-            } else if (collide == COLLIDE_RIGHT) {
-                while (collide == COLLIDE_RIGHT) {
-                    check.x--;
-                    collide = collisionCheck(game->placed, rotated, check);
-                }
-            }
-            if (collide == COLLIDE_NONE) {
-                memcpy(&piece_position, &check, sizeof(SDL_Point));
-                memcpy(current_piece, rotated, sizeof(uint8_t) * PIECE_SIZE);
-            }
-            break;
-        }
-        case SDLK_ESCAPE:
-            return UPDATE_PAUSE;
+    if (key == SDLK_ESCAPE) {
+        return UPDATE_PAUSE;
     }
 
-    if (frame % fall_speed == 0) {
-        SDL_Point check = {.x = piece_position.x, .y = piece_position.y + 1};
-        if (!collisionCheck(game->placed, current_piece, check)) {
-            piece_position.y++;
-        } else {
-            Size size;
-            getPieceSize(current_piece, &size);
-            if (piece_position.y + size.start_y - size.h < 0) {
-                addToPlaced(game->placed, current_piece, piece_position);
-                return UPDATE_LOSE;
-            } else {
-                fall_speed = 30;
-                addToPlaced(game->placed, current_piece, piece_position);
-                pickPiece(current_piece, &color);
-                piece_position.y = -1;
+    //Every key event reaches the simulation in order, before the first tick due after it happened
+    for (uint32_t i = 0; i < ticks && !(events & TETRIS_EVENT_GAME_OVER); i++) {
+        uint64_t start = tickDue(game, game->sim_ticks);
+        uint64_t due = tickDue(game, game->sim_ticks + 1);
+        InputEvent event;
+        //The bot's keys go down at the start of the tick it decided them in
+        if (game->bot_playing) {
+            BotInput inputs[BOT_INPUTS_MAX];
+            int count = Bot_Inputs(&game->bot, state, inputs);
+            for (int j = 0; j < count; ++j) {
+                InputQueue_Push(&game->input, inputToKey(inputs[j].input), inputs[j].pressed, start);
             }
         }
+        while (InputQueue_Pop(&game->input, due, &event)) {
+            //Where inside the tick the key went down or up, so auto-repeat timing is not rounded to ticks
+            uint32_t offset = event.time > start ? (uint32_t)((event.time - start) * 1000 / game->perf_frequency) : 0;
+            uint32_t time = Tetris_Time(state) + offset;
+            Replay_Input(&game->replay, state, keyToInput(event.key), event.pressed, time);
+            events |= Tetris_Input(state, keyToInput(event.key), event.pressed, time);
+        }
+        events |= Tetris_Step(state, TETRIS_INPUT_NONE);
+        Replay_Step(&game->replay, state);
+        game->sim_ticks++;
     }
 
-    uint8_t lines = checkForRowClearing(game->placed);
-    game->total_rows_cleared += lines;
-    if (game->total_rows_cleared >= (game->level + 1) * 10) {
-        game->level++;
-        fall_speed = MAX(1, fall_speed - 2);
+    SDL_Rect arena_rect = {
+        .x = ARENA_PADDING_PX,
+        .y = 0,
+        .w = ARENA_WIDTH_PX,
+        .h = ARENA_HEIGHT_PX
+    };
+    updateBoard(game);
+    SDL_RenderCopy(game->renderer, game->board, NULL, &arena_rect);
+    SDL_RenderSetViewport(game->renderer, &arena_rect);
+    uint8_t color = piece_colors[state->pieces % PIECE_COLOR_SIZE];
+    Position landing = {.x = state->position.x, .y = (int8_t)Tetris_DropRow(state)};
+    if (landing.y != state->position.y) {
+        drawGhost(&game->blocks, state->piece, landing, color);
     }
+    drawTetromino(&game->blocks, state->piece, state->position, color);
+    flushBlocks(game->renderer, &game->blocks);
+    drawPreview(game);
+    SDL_RenderSetViewport(game->renderer, NULL);
 
     SDL_Point point = {.x = ARENA_PADDING_PX / 2, .y = 100};
-    char score_string[255];
-    game->score += findPoints(game->level, lines);
-    sprintf(score_string, "Score: %ld", game->score);
-    drawText(game->renderer, game->ui_font, score_string, point);
+    drawNumber(game, game->ui_font, "Score: ", state->score, point);
 
     SDL_Point level_point = {.x = ARENA_PADDING_PX / 2, .y = 150};
-    char level_string[255];
-    sprintf(level_string, "Level: %d", game->level);
-    drawText(game->renderer, game->ui_font, level_string, level_point);
+    drawNumber(game, game->ui_font, "Level: ", state->level, level_point);
 
-    drawPlaced(game->placed, game->renderer);
+    if ((events & TETRIS_EVENT_GAME_OVER) && game->bot_playing) {
+        startMatch(game);
+        return UPDATE_MAIN;
+    }
+    if (events & TETRIS_EVENT_GAME_OVER) {
+        saveReplay(game);
+        return UPDATE_LOSE;
+    }
     return UPDATE_MAIN;
 }
+//Starts a new frame schedule at the current time, e.g. after the loop was blocked waiting for input
+void FramePacer_Reset(FramePacer *pacer){
+    pacer->origin = SDL_GetPerformanceCounter();
+    pacer->frame = 0;
+    pacer->last_present = 0;
+}
+void FramePacer_Init(FramePacer *pacer, uint32_t fps){
+    memset(pacer, 0, sizeof(FramePacer));
+    pacer->frequency = SDL_GetPerformanceFrequency();
+    pacer->fps = fps;
+    FramePacer_Reset(pacer);
+}
+//Sleeps for most of the time left before deadline, then spins for the rest
+static void waitUntil(uint64_t deadline, uint64_t frequency){
+    const uint64_t spin = frequency * PACER_SPIN_US / 1000000;
+    for (;;) {
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now >= deadline) {
+            return;
+        }
+        uint64_t remaining = deadline - now;
+        if (remaining > spin) {
+            SDL_Delay((uint32_t)((remaining - spin) * 1000 / frequency));
+        }
+    }
+}
+//Shows the frame straight away, records how far its interval strayed from the ideal and then
+//waits for the next frame's deadline, so input read at the start of the next frame is as fresh as possible
+void FramePacer_Present(FramePacer *pacer, SDL_Renderer *renderer){
+    SDL_RenderPresent(renderer);
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint64_t ideal = pacer->frequency / pacer->fps;
+    if (pacer->last_present != 0) {
+        uint64_t interval = now - pacer->last_present;
+        uint64_t jitter = interval > ideal ? interval - ideal : ideal - interval;
+        pacer->samples++;
+        pacer->total_jitter += jitter;
+        pacer->max_jitter = MAX(pacer->max_jitter, jitter);
+    }
+    pacer->last_present = now;
+    pacer->frame++;
+    uint64_t deadline = pacer->origin + pacer->frame * pacer->frequency / pacer->fps;
+    if (now >= deadline) {
+        //A frame later than a whole interval starts a new schedule instead of rushing the next ones
+        if (now - deadline > ideal) {
+            pacer->origin = now;
+            pacer->frame = 0;
+        }
+        return;
+    }
+    waitUntil(deadline, pacer->frequency);
+}
+//Prints the measured frame time jitter
+void FramePacer_Report(const FramePacer *pacer){
+    if (pacer->samples == 0) {
+        return;
+    }
+    uint64_t mean_us = pacer->total_jitter * 1000000 / pacer->samples / pacer->frequency;
+    uint64_t max_us = pacer->max_jitter * 1000000 / pacer->frequency;
+    printf("Frame pacing: %lu frames at %u fps, mean jitter %lu us, worst %lu us\n", pacer->samples, pacer->fps, mean_us, max_us);
+}
+//Lets go of every action the match still has held, as key releases it records, so a key released while the game
+//was not listening neither stays down nor keeps auto-repeating, and the replay still plays back what was played
+static void releaseHeld(Game *game){
+    TetrisState *state = &game->state;
+    while (state->held != TETRIS_INPUT_NONE) {
+        uint8_t input = state->held & -state->held;
+        Replay_Input(&game->replay, state, input, false, Tetris_Time(state));
+        Tetris_Input(state, input, false, Tetris_Time(state));
+    }
+}
 //Main Game Loop
 void Game_Update(Game *game, const uint8_t fps){
-    uint64_t frame = 0;
     bool quit = false;
     bool keydown = false;
     uint8_t update_id = UPDATE_MAIN;
     Update_callback update;
-    float mspd = (1.0f / (float)fps) * 1000.0f;
-
-    SDL_Rect arena_background_rect = {
-        .x = ARENA_PADDING_PX,
-        .y = 0,
-        .w = ARENA_WIDTH_PX,
-        .h = ARENA_HEIGHT_PX
-    };
+    FramePacer pacer;
+    FramePacer_Init(&pacer, fps);
+    bool redraw = true;  // Overlay screens (pause, game over) are only drawn when something invalidated them
+    resetSimClock(game);
 
     while (!quit) {
-        uint32_t start = SDL_GetTicks();
-
         switch (update_id) {
             case UPDATE_MAIN: update = updateMain; break;
             case UPDATE_LOSE: update = updateLose; break;
@@ -736,10 +902,11 @@ void Game_Update(Game *game, const uint8_t fps){
             case UPDATE_GAME_OVER: update = updateGameOver; break;
         }
 
-        setColor(game->renderer, COLOR_GREY);
-        SDL_RenderClear(game->renderer);
-        setColor(game->renderer, COLOR_BLACK);
-        SDL_RenderFillRect(game->renderer, &arena_background_rect);
+        //Overlays never change on their own, so block until an event arrives instead of spinning at full frame rate
+        bool idle = update_id == UPDATE_PAUSE || update_id == UPDATE_LOSE;
+        if (idle && !redraw && !SDL_WaitEventTimeout(NULL, IDLE_REFRESH_MS)) {
+            redraw = true;
+        }
 
         SDL_Event event;
         int key = 0;
@@ -750,31 +917,79 @@ void Game_Update(Game *game, const uint8_t fps){
                     if (event.key.repeat == 0) {
                       key = event.key.keysym.sym;
                       keydown = true;
+                      redraw = true;
+                      if (update_id == UPDATE_MAIN && !game->bot_playing) {
+                          InputQueue_Push(&game->input, event.key.keysym.sym, true, SDL_GetPerformanceCounter());
+                      }
                     }
 
                     break;
                 }
 
-                case SDL_KEYUP: keydown = false; break;
+                case SDL_KEYUP: {
+                    keydown = false;
+                    if (update_id == UPDATE_MAIN && !game->bot_playing) {
+                        InputQueue_Push(&game->input, event.key.keysym.sym, false, SDL_GetPerformanceCounter());
+                    }
+                    break;
+                }
+                case SDL_WINDOWEVENT: redraw = true; break;
+                case SDL_RENDER_TARGETS_RESET: game->board_dirty = true; redraw = true; break;
                 case SDL_QUIT: quit = true; break;
             }
         }
 
-        update_id = update(game, frame, (SDL_KeyCode)key, keydown);
+        if (idle && !redraw) {
+            continue;
+        }
 
-        uint32_t end = SDL_GetTicks();
-        uint32_t elapsed_time = end - start;
+        //The simulation runs at TETRIS_TICK_HZ whatever the frame rate, catching up after slow frames
+        uint32_t ticks = 0;
+        if (update_id == UPDATE_MAIN) {
+            uint64_t now = SDL_GetPerformanceCounter();
+            while (ticks < MAX_TICKS_PER_FRAME && tickDue(game, game->sim_ticks + ticks + 1) <= now) {
+                ticks++;
+            }
+        }
 
-        if (elapsed_time < mspd) {
-            elapsed_time = mspd - elapsed_time;
-            SDL_Delay(elapsed_time);
-        } 
-        SDL_RenderPresent(game->renderer);
-        frame++;
+        setColor(game->renderer, COLOR_GREY);
+        SDL_RenderClear(game->renderer);
+
+        uint8_t next_id = update(game, ticks, (SDL_KeyCode)key, keydown);
+        redraw = next_id != update_id;
+        update_id = next_id;
+        if (redraw) {
+            //Time spent paused or on the login screen must not be simulated afterwards, nor keys pressed there
+            if (update_id != UPDATE_MAIN) {
+                releaseHeld(game);
+            }
+            resetSimClock(game);
+            InputQueue_Clear(&game->input);
+            FramePacer_Reset(&pacer);
+        } else if (ticks == MAX_TICKS_PER_FRAME && tickDue(game, game->sim_ticks + 1) <= SDL_GetPerformanceCounter()) {
+            //Too far behind to catch up: let the game slow down rather than stall rendering
+            resetSimClock(game);
+        }
+
+        if (idle) {
+            SDL_RenderPresent(game->renderer);
+            FramePacer_Reset(&pacer);
+        } else {
+            FramePacer_Present(&pacer, game->renderer);
+        }
     }
+    FramePacer_Report(&pacer);
 }
 
 void Game_Quit(Game *game){
+    saveReplay(game);
+    Replay_Free(&game->replay);
+    if (game->bot_playing) {
+        Bot_Free(&game->bot);
+        ThreadPool_Stop(&game->pool);
+    }
+    clearTextCache(&game->text_cache);
+    SDL_DestroyTexture(game->board);
     TTF_CloseFont(game->lose_font);
     TTF_CloseFont(game->ui_font);
     SDL_DestroyWindow(game->window);
@@ -800,29 +1015,39 @@ void Game_Login(Game *game, char *username, size_t username_size) {
         .h = 100 
     };
 
-    game->score = 0;
-    game->level = 0;
-    game->total_rows_cleared = 0;
-    memset(game->placed, 0, sizeof(uint8_t) * ARENA_SIZE);
+    startMatch(game);
 
+    bool redraw = true;
     while (!quit && !enter_pressed) {
-        // Process events
+        // Sleep until there is input; the screen only changes when the name does
         SDL_Event event;
+        if (!redraw && !SDL_WaitEventTimeout(NULL, IDLE_REFRESH_MS)) {
+            redraw = true;
+        }
+        // Process events
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 quit = true;
             } else if (event.type == SDL_TEXTINPUT) {
                 if (strlen(username) < username_size - 1) {
                     strcat(username, event.text.text);
+                    redraw = true;
                 }
             } else if (event.type == SDL_KEYDOWN) {
                 if (event.key.keysym.sym == SDLK_BACKSPACE && strlen(username) > 0) {
                     username[strlen(username) - 1] = '\0';
+                    redraw = true;
                 } else if (event.key.keysym.sym == SDLK_RETURN && strlen(username) > 0) {
                     enter_pressed = true;
                 }
+            } else if (event.type == SDL_WINDOWEVENT) {
+                redraw = true;
             }
         }
+        if (!redraw || quit || enter_pressed) {
+            continue;
+        }
+        redraw = false;
         // Clear screen with a modern gradient background
         SDL_SetRenderDrawColor(game->renderer, 35, 41, 50, 255);
         SDL_RenderClear(game->renderer);
@@ -858,7 +1083,7 @@ void Game_Login(Game *game, char *username, size_t username_size) {
             .x = SCREEN_WIDTH_PX / 2,
             .y = SCREEN_HEIGHT_PX - 190
         };
-        drawText(game->renderer, game->ui_font, "Welcome to Tetris!", welcome_pos);
+        drawText(game, game->ui_font, "Welcome to Tetris!", welcome_pos);
         char display_text[256];
         if (strlen(username) == 0) {
             strcpy(display_text, "Enter Your Name:  ");
@@ -869,12 +1094,12 @@ void Game_Login(Game *game, char *username, size_t username_size) {
             .x = SCREEN_WIDTH_PX / 2,
             .y = SCREEN_HEIGHT_PX - 140
         };
-        drawText(game->renderer, game->ui_font, display_text, text_position);
+        drawText(game, game->ui_font, display_text, text_position);
         SDL_Point instructions_pos = {
             .x = SCREEN_WIDTH_PX / 2,
             .y = SCREEN_HEIGHT_PX - 90
         };
-        drawText(game->renderer, game->ui_font, "Press ENTER to Start", instructions_pos);
+        drawText(game, game->ui_font, "Press ENTER to Start", instructions_pos);
         SDL_RenderPresent(game->renderer);
     }
     SDL_StopTextInput();
@@ -884,7 +1109,7 @@ void Game_Login(Game *game, char *username, size_t username_size) {
         Game_Quit(game);
         exit(0);
     }
-    strncpy(current_username, username, sizeof(current_username) - 1);
+    strncpy(game->username, username, sizeof(game->username) - 1);
 }
 //Setting Color for smth smth 
 void setColor(SDL_Renderer *renderer, uint8_t color){
@@ -904,7 +1129,39 @@ int main(int argc, char *argv[]){
     Game game;
     char username[50];
     Game_Init(&game);
-    Game_Login(&game, username, sizeof(username));
+    //Optional settings: --das <ms> --arr <ms> --seed <n> --randomizer uniform|bag|history
+    //--bot <depth> lets the bot play (attract mode), --beam <n> sets how many positions it keeps
+    uint8_t bot_depth = 0;
+    uint8_t bot_beam = BOT_BEAM;
+    const char *randomizers[TETRIS_RANDOMIZER_COUNT] = {"uniform", "bag", "history"};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        int value = MIN(MAX(atoi(argv[i + 1]), 0), UINT8_MAX);
+        if (strcmp(argv[i], "--das") == 0) {
+            game.das = value;
+        } else if (strcmp(argv[i], "--arr") == 0) {
+            game.arr = value;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            game.seed = strtoull(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--bot") == 0) {
+            bot_depth = value;
+        } else if (strcmp(argv[i], "--beam") == 0) {
+            bot_beam = value;
+        } else if (strcmp(argv[i], "--randomizer") == 0) {
+            for (uint8_t r = 0; r < TETRIS_RANDOMIZER_COUNT; ++r) {
+                if (strcmp(argv[i + 1], randomizers[r]) == 0) {
+                    game.randomizer = r;
+                }
+            }
+        }
+    }
+    if (bot_depth > 0) {
+        END(!ThreadPool_Start(&game.pool, ThreadPool_DefaultThreads()), "Could not start the bot", "no threads");
+        END(!Bot_Init(&game.bot, &game.pool, bot_depth, bot_beam), "Could not start the bot", "out of memory");
+        game.bot_playing = true;
+        startMatch(&game);
+    } else {
+        Game_Login(&game, username, sizeof(username));
+    }
     Game_Update(&game, 60);
     Game_Quit(&game);
     return 0;
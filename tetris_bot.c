@@ -0,0 +1,218 @@
+//Preprocessor Directives
+#include <stdlib.h>
+#include <string.h>
+#include "tetris_bot.h"
+
+//Whether node a ranks above b: higher score, then lower id, so the beam is the same whatever the thread count
+static bool better(const BotNode *a, const BotNode *b){
+    return a->score != b->score ? a->score > b->score : a->id < b->id;
+}
+//qsort order of a beam, best first
+static int compareNodes(const void *a, const void *b){
+    return better((const BotNode *)a, (const BotNode *)b) ? -1 : 1;
+}
+//Offers node to a min-heap of at most width nodes, where heap[0] is the worst one kept
+static void keepBest(BotNode *heap, uint32_t *count, uint32_t width, const BotNode *node){
+    uint32_t i;
+    if (*count < width) {
+        //Sift the new last node up past better parents
+        for (i = (*count)++; i > 0 && better(&heap[(i - 1) / 2], node); i = (i - 1) / 2) {
+            heap[i] = heap[(i - 1) / 2];
+        }
+        heap[i] = *node;
+        return;
+    }
+    if (!better(node, &heap[0])) {
+        return;
+    }
+    //Replace the worst and sift it down past worse children
+    for (i = 0; 2 * i + 1 < *count;) {
+        uint32_t child = 2 * i + 1;
+        if (child + 1 < *count && better(&heap[child], &heap[child + 1])) {
+            child++;
+        }
+        if (!better(node, &heap[child])) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = *node;
+}
+//Sets up a bot searching depth pieces with a beam of beam_width, on pool's workers if pool is not NULL.
+//All the memory the search needs is allocated here
+bool Bot_Init(Bot *bot, ThreadPool *pool, uint8_t depth, uint8_t beam_width){
+    memset(bot, 0, sizeof(Bot));
+    bot->pool = pool;
+    bot->depth = MIN(MAX(depth, 1), BOT_MAX_DEPTH);
+    bot->beam_width = MIN(MAX(beam_width, 1), BOT_MAX_BEAM);
+    bot->weights = Eval_DefaultWeights;
+    int workers = pool != NULL ? pool->count : 1;
+    bot->arenas = (BotArena *)calloc(workers, sizeof(BotArena));
+    bot->beam = (BotNode *)calloc(BOT_MAX_BEAM, sizeof(BotNode));
+    bot->merged = (BotNode *)calloc((size_t)workers * BOT_MAX_BEAM, sizeof(BotNode));
+    if (bot->arenas == NULL || bot->beam == NULL || bot->merged == NULL) {
+        Bot_Free(bot);
+        return false;
+    }
+    return true;
+}
+void Bot_Free(Bot *bot){
+    free(bot->arenas);
+    free(bot->beam);
+    free(bot->merged);
+    bot->arenas = NULL;
+    bot->beam = NULL;
+    bot->merged = NULL;
+}
+//Scores the children waiting in arena's batch and keeps the best of them
+static void scoreBatch(Bot *bot, BotArena *arena, const BotNode *parent, uint32_t parent_index){
+    Eval_BatchScore(&arena->batch, &bot->weights, arena->scores);
+    for (uint32_t i = 0; i < arena->batch.count; ++i) {
+        BotNode child;
+        for (int y = 0; y < ARENA_HEIGHT; ++y) {
+            child.placed[y] = arena->batch.rows[y][i];
+        }
+        child.score = parent->score + arena->scores[i];
+        //Children of the root start their own lines
+        bool first = parent_index == UINT32_MAX;
+        child.id = first ? arena->parents[i] : parent_index * MOVES_MAX + arena->parents[i];
+        child.root = first ? arena->parents[i] : parent->root;
+        keepBest(arena->best, &arena->count, bot->beam_width, &child);
+    }
+    arena->batch.count = 0;
+}
+//Places piece every way it can go from position on the arena of parent, keeping the best children in arena.
+//parent_index is UINT32_MAX for the root
+static void expandNode(Bot *bot, BotArena *arena, const BotNode *parent, uint32_t parent_index, Piece piece,
+                       Position position){
+    int count = Moves_Generate(parent->placed, piece, position, arena->moves);
+    for (int m = 0; m < count; ++m) {
+        int i = Eval_BatchAdd(&arena->batch, parent->placed, arena->moves[m]);
+        if (i >= 0) {
+            arena->parents[i] = (uint16_t)m;
+        }
+        if (arena->batch.count == EVAL_BATCH) {
+            scoreBatch(bot, arena, parent, parent_index);
+        }
+    }
+    scoreBatch(bot, arena, parent, parent_index);
+}
+//Pool task: expands one slice of the beam with the worker's own arena
+static void expandTask(void *arg, int worker){
+    BotTask *task = (BotTask *)arg;
+    Bot *bot = task->bot;
+    Piece piece = {task->type, 0};
+    Position spawn = {(int8_t)getShape(piece)->spawn_x, -1};
+    for (uint32_t i = task->first; i < task->first + task->count; ++i) {
+        expandNode(bot, &bot->arenas[worker], &bot->beam[i], i, piece, spawn);
+    }
+}
+//Replaces the beam with the best children every worker kept, best first
+static void mergeBeam(Bot *bot, int workers){
+    uint32_t count = 0;
+    for (int w = 0; w < workers; ++w) {
+        memcpy(&bot->merged[count], bot->arenas[w].best, bot->arenas[w].count * sizeof(BotNode));
+        count += bot->arenas[w].count;
+        bot->arenas[w].count = 0;
+    }
+    qsort(bot->merged, count, sizeof(BotNode), compareNodes);
+    bot->beam_count = MIN(count, bot->beam_width);
+    memcpy(bot->beam, bot->merged, bot->beam_count * sizeof(BotNode));
+}
+//Picks the placement for the falling piece of state, from where it is now: the one starting the best line of
+//bot->depth placements through the preview. Each depth the beam is split into one slice per pool worker.
+//Fails only if the piece cannot lock anywhere without ending the match
+bool Bot_Choose(Bot *bot, const TetrisState *state, Move *move){
+    int workers = bot->pool != NULL ? bot->pool->count : 1;
+    BotNode root = {{0}, 0, 0, 0};
+    memcpy(root.placed, state->placed, ARENA_HEIGHT);
+    expandNode(bot, &bot->arenas[0], &root, UINT32_MAX, state->piece, state->position);
+    //Keep the root's moves to map the winning line back to its first placement
+    memcpy(bot->roots, bot->arenas[0].moves, sizeof(bot->roots));
+    mergeBeam(bot, workers);
+    if (bot->beam_count == 0) {
+        return false;
+    }
+    BotNode best = bot->beam[0];
+    for (uint8_t d = 1; d < bot->depth && bot->beam_count > 0; ++d) {
+        uint32_t slices = MIN((uint32_t)workers, bot->beam_count);
+        for (uint32_t s = 0; s < slices; ++s) {
+            BotTask *task = &bot->tasks[s];
+            task->bot = bot;
+            task->type = state->next[d - 1];
+            task->first = s * bot->beam_count / slices;
+            task->count = (s + 1) * bot->beam_count / slices - task->first;
+            if (bot->pool != NULL) {
+                ThreadPool_Submit(bot->pool, expandTask, task);
+            } else {
+                expandTask(task, 0);
+            }
+        }
+        if (bot->pool != NULL) {
+            ThreadPool_Wait(bot->pool);
+        }
+        mergeBeam(bot, workers);
+        //A depth where every line ends the match leaves the best line found so far
+        if (bot->beam_count > 0) {
+            best = bot->beam[0];
+        }
+    }
+    *move = bot->roots[best.root];
+    return true;
+}
+//Key presses and releases that carry on towards the chosen placement, for the caller to feed to Tetris_Input
+//(or a replay) in order. Called again once those have been applied, it picks up from wherever the piece ended up,
+//choosing a new target when a new piece has spawned or the old one can no longer be reached. Shifts and turns are
+//tapped all at once, soft drop is held for the rows a tuck needs, and the piece is hard dropped once nothing but
+//falling is left. Returns the number of inputs
+int Bot_Inputs(Bot *bot, const TetrisState *state, BotInput *inputs){
+    uint8_t path[BOT_PATH_MAX];
+    int length = -1;
+    int count = 0;
+    if (state->game_over) {
+        return 0;
+    }
+    if (bot->has_target && bot->planned_piece == state->pieces) {
+        length = Moves_Path(state->placed, state->piece, state->position, bot->target, path, BOT_PATH_MAX);
+    }
+    if (length < 0) {
+        bot->has_target = Bot_Choose(bot, state, &bot->target);
+        bot->planned_piece = state->pieces;
+        length = bot->has_target ? Moves_Path(state->placed, state->piece, state->position, bot->target, path, BOT_PATH_MAX) : 0;
+        length = MAX(length, 0);
+    }
+    int taps = 0;
+    while (taps < length && path[taps] != TETRIS_INPUT_SOFT_DROP) {
+        taps++;
+    }
+    int drops = taps;
+    while (drops < length && path[drops] == TETRIS_INPUT_SOFT_DROP) {
+        drops++;
+    }
+    //Soft drop is only held while the path still has to go down before its next shift or turn
+    bool hold = taps == 0 && drops < length;
+    if (((state->held & TETRIS_INPUT_SOFT_DROP) != 0) != hold) {
+        inputs[count++] = (BotInput){TETRIS_INPUT_SOFT_DROP, hold};
+    }
+    if (hold) {
+        return count;
+    }
+    for (int i = 0; i < taps; ++i) {
+        inputs[count++] = (BotInput){path[i], true};
+        inputs[count++] = (BotInput){path[i], false};
+    }
+    //Nothing left but falling: drop it now
+    if (drops == length) {
+        inputs[count++] = (BotInput){TETRIS_INPUT_HARD_DROP, true};
+        inputs[count++] = (BotInput){TETRIS_INPUT_HARD_DROP, false};
+    }
+    return count;
+}
+//Plays move on state straight away, for simulations that need no key presses: the piece is put where move leaves
+//it and locked by a hard drop step. move must be one Moves_Generate found from where the piece is now
+void Bot_Play(TetrisState *state, Move move){
+    state->piece = move.piece;
+    state->position = move.position;
+    Tetris_Step(state, TETRIS_INPUT_HARD_DROP);
+}
@@ -0,0 +1,69 @@
+//Beam search player: looks ahead through the preview with the move generator and the evaluator, and plays the
+//chosen placement through the same press/release inputs a player would
+#ifndef TETRIS_BOT_H
+#define TETRIS_BOT_H
+
+#include "tetris_eval.h"
+#include "tetris_pool.h"
+
+//Macro Definitions
+#define BOT_MAX_DEPTH (1 + TETRIS_PREVIEW)     // the falling piece and every previewed one
+#define BOT_MAX_BEAM 64U                       // positions kept between pieces
+#define BOT_DEPTH 3U                           // defaults
+#define BOT_BEAM 32U
+#define BOT_PATH_MAX 64                        // steps of a path to a placement the bot will follow
+#define BOT_INPUTS_MAX (2 * BOT_PATH_MAX + 3)  // events Bot_Inputs can return at once
+
+//An arena the search reached and how it got there
+typedef struct BotNode {
+    uint8_t placed[ARENA_HEIGHT];
+    int32_t score;                   // evaluation of every placement on the way, summed
+    uint32_t id;                     // parent's place in its beam * MOVES_MAX + move, to break ties the same way every run
+    uint16_t root;                   // placement of the falling piece this line starts with
+} BotNode;
+//Scratch space of one worker, so the search never allocates
+typedef struct BotArena {
+    EvalBatch batch;
+    int32_t scores[EVAL_BATCH];
+    Move moves[MOVES_MAX];
+    uint16_t parents[EVAL_BATCH];    // move of each batch entry
+    BotNode best[BOT_MAX_BEAM];      // min-heap of the best children this worker found, worst on top
+    uint32_t count;
+} BotArena;
+typedef struct Bot Bot;
+//A slice of the beam one pool task expands
+typedef struct BotTask {
+    Bot *bot;
+    uint32_t first;
+    uint32_t count;
+    uint8_t type;                    // piece dealt at this depth
+} BotTask;
+struct Bot {
+    ThreadPool *pool;                // NULL to search on the calling thread
+    uint8_t depth;                   // pieces searched, the falling one included; at most BOT_MAX_DEPTH
+    uint8_t beam_width;              // at most BOT_MAX_BEAM
+    EvalWeights weights;
+    BotArena *arenas;                // one per pool worker
+    BotNode *beam;                   // BOT_MAX_BEAM positions being expanded
+    BotNode *merged;                 // every worker's best children
+    uint32_t beam_count;
+    BotTask tasks[POOL_MAX_THREADS];
+    Move roots[MOVES_MAX];           // placements of the falling piece
+    //Following the chosen placement
+    Move target;
+    uint32_t planned_piece;          // TetrisState.pieces the target was chosen for
+    bool has_target;                 // clear it when a new match starts
+};
+//One press or release for Tetris_Input
+typedef struct BotInput {
+    uint8_t input;
+    bool pressed;
+} BotInput;
+
+bool Bot_Init(Bot *bot, ThreadPool *pool, uint8_t depth, uint8_t beam_width);
+void Bot_Free(Bot *bot);
+bool Bot_Choose(Bot *bot, const TetrisState *state, Move *move);
+int Bot_Inputs(Bot *bot, const TetrisState *state, BotInput *inputs);
+void Bot_Play(TetrisState *state, Move move);
+
+#endif
@@ -0,0 +1,549 @@
+//Preprocessor Directives
+#include <string.h>
+#include "tetris_core.h"
+
+//calculate score based on current level
+int findPoints(uint8_t level, uint8_t lines){
+    switch (lines) {
+        case 1: return 40 * (level + 1);
+        case 2: return 100 * (level + 1);
+        case 3: return 300 * (level + 1);
+        case 4: return 1200 * (level + 1);
+    }
+    return 0;
+}
+//Every rotation of every tetromino, precomputed by turning the 4x4 spawn shape 90 degrees clockwise.
+//Each entry holds one bitmask per row (bit x is column x of the 4x4 box), the bounding box, the spawn column and
+//the bottom profile
+static const Shape shapes[PIECE_COUNT][ROTATION_COUNT] = {
+    [PIECE_I] = {
+        {{0x0, 0xF, 0x0, 0x0}, 4, 1, 0, 1, 2, { 1,  1,  1,  1}},
+        {{0x4, 0x4, 0x4, 0x4}, 1, 4, 2, 0, 4, {-1, -1,  3, -1}},
+        {{0x0, 0x0, 0xF, 0x0}, 4, 1, 0, 2, 2, { 2,  2,  2,  2}},
+        {{0x2, 0x2, 0x2, 0x2}, 1, 4, 1, 0, 4, {-1,  3, -1, -1}},
+    },
+    [PIECE_J] = {
+        {{0x0, 0x1, 0x7, 0x0}, 3, 2, 0, 1, 3, { 2,  2,  2, -1}},
+        {{0x6, 0x2, 0x2, 0x0}, 2, 3, 1, 0, 3, {-1,  2,  0, -1}},
+        {{0x0, 0xE, 0x8, 0x0}, 3, 2, 1, 1, 3, {-1,  1,  1,  2}},
+        {{0x0, 0x4, 0x4, 0x6}, 2, 3, 1, 1, 3, {-1,  3,  3, -1}},
+    },
+    [PIECE_L] = {
+        {{0x0, 0x4, 0x7, 0x0}, 3, 2, 0, 1, 3, { 2,  2,  2, -1}},
+        {{0x2, 0x2, 0x6, 0x0}, 2, 3, 1, 0, 3, {-1,  2,  2, -1}},
+        {{0x0, 0xE, 0x2, 0x0}, 3, 2, 1, 1, 3, {-1,  2,  1,  1}},
+        {{0x0, 0x6, 0x4, 0x4}, 2, 3, 1, 1, 3, {-1,  1,  3, -1}},
+    },
+    [PIECE_O] = {
+        {{0x0, 0x6, 0x6, 0x0}, 2, 2, 1, 1, 3, {-1,  2,  2, -1}},
+        {{0x0, 0x6, 0x6, 0x0}, 2, 2, 1, 1, 3, {-1,  2,  2, -1}},
+        {{0x0, 0x6, 0x6, 0x0}, 2, 2, 1, 1, 3, {-1,  2,  2, -1}},
+        {{0x0, 0x6, 0x6, 0x0}, 2, 2, 1, 1, 3, {-1,  2,  2, -1}},
+    },
+    [PIECE_S] = {
+        {{0x0, 0x6, 0x3, 0x0}, 3, 2, 0, 1, 3, { 2,  2,  1, -1}},
+        {{0x2, 0x6, 0x4, 0x0}, 2, 3, 1, 0, 3, {-1,  1,  2, -1}},
+        {{0x0, 0xC, 0x6, 0x0}, 3, 2, 1, 1, 3, {-1,  2,  2,  1}},
+        {{0x0, 0x2, 0x6, 0x4}, 2, 3, 1, 1, 3, {-1,  2,  3, -1}},
+    },
+    [PIECE_T] = {
+        {{0x0, 0x2, 0x7, 0x0}, 3, 2, 0, 1, 3, { 2,  2,  2, -1}},
+        {{0x2, 0x6, 0x2, 0x0}, 2, 3, 1, 0, 3, {-1,  2,  1, -1}},
+        {{0x0, 0xE, 0x4, 0x0}, 3, 2, 1, 1, 3, {-1,  1,  2,  1}},
+        {{0x0, 0x4, 0x6, 0x4}, 2, 3, 1, 1, 3, {-1,  2,  3, -1}},
+    },
+    [PIECE_Z] = {
+        {{0x0, 0x3, 0x6, 0x0}, 3, 2, 0, 1, 3, { 1,  2,  2, -1}},
+        {{0x4, 0x6, 0x2, 0x0}, 2, 3, 1, 0, 3, {-1,  2,  1, -1}},
+        {{0x0, 0x6, 0xC, 0x0}, 3, 2, 1, 1, 3, {-1,  1,  2,  2}},
+        {{0x0, 0x4, 0x6, 0x2}, 2, 3, 1, 1, 3, {-1,  3,  2, -1}},
+    },
+};
+//looks up the precomputed shape of a piece in its current rotation
+const Shape *getShape(Piece piece){
+    return &shapes[piece.type][piece.rotation];
+}
+//Rotating a Tetromino piece 90 degrees clockwise
+Piece rotatePiece(Piece piece){
+    piece.rotation = (piece.rotation + 1) % ROTATION_COUNT;
+    return piece;
+}
+//moves a piece row mask to arena column x (bits pushed past either wall are dropped)
+uint8_t shiftRow(uint8_t mask, int x){
+    return x >= 0 ? (uint8_t)(mask << x) : (uint8_t)(mask >> -x);
+}
+//detecting and clearing fully occupied rows in arena. One bottom-up pass copies each kept row straight to where
+//it ends up and zero-fills the rows freed at the top. Returns a mask with bit y set for every arena row y
+//(numbered before the clear) that was full
+uint32_t checkForRowClearing(uint8_t *placed){
+    uint32_t cleared = 0;
+    int write = ARENA_HEIGHT - 1;
+    for (int y = ARENA_HEIGHT - 1; y >= 0; --y) {
+        if (placed[y] == ROW_FULL) {
+            cleared |= 1UL << y;
+        } else {
+            placed[write--] = placed[y];
+        }
+    }
+    if (write >= 0) {
+        memset(placed, 0, write + 1);
+    }
+    return cleared;
+}
+//Adding a Tetromino piece to placed array
+void addToPlaced(uint8_t *placed, Piece piece, Position position){
+    const Shape *shape = getShape(piece);
+    for (int y = 0; y < PIECE_HEIGHT; ++y) {
+        int arena_y = position.y + y;
+        if (arena_y >= 0 && arena_y < ARENA_HEIGHT) {
+            placed[arena_y] |= shiftRow(shape->rows[y], position.x);
+        }
+    }
+}
+//Detecting collision between pieces and boundary
+uint8_t collisionCheck(const uint8_t *placed, Piece piece, Position position){
+    const Shape *shape = getShape(piece);
+    uint8_t collide = COLLIDE_NONE;
+    if (position.x < -shape->start_x) {
+        collide |= COLLIDE_LEFT;
+        }
+    if (position.x + shape->start_x + shape->w > (int)ARENA_WIDTH){
+        collide |= COLLIDE_RIGHT;
+        }
+    if (position.y + shape->start_y + shape->h > (int)ARENA_HEIGHT){
+        collide |= COLLIDE_BOTTOM;
+        }
+    //rows above the arena are empty and rows below it were reported as COLLIDE_BOTTOM
+    for (int y = 0; y < PIECE_HEIGHT; ++y) {
+        int arena_y = position.y + y;
+        if (arena_y < 0 || arena_y >= ARENA_HEIGHT) {
+            continue;
+        }
+        if (placed[arena_y] & shiftRow(shape->rows[y], position.x)) {
+            collide |= COLLIDE_PIECE;
+            return collide;
+        }
+    }
+    return collide;
+}
+//Columns the piece can travel in direction dx (-1 or 1) before it meets a wall or a block, in one pass over
+//its rows. Every row of every tetromino is one contiguous run of cells, so for each row this is just the run of
+//free cells next to it
+int slideDistance(const uint8_t *placed, Piece piece, Position position, int dx){
+    const Shape *shape = getShape(piece);
+    int distance = ARENA_WIDTH;
+    for (int y = 0; y < PIECE_HEIGHT; ++y) {
+        if (shape->rows[y] == 0) {
+            continue;
+        }
+        int arena_y = position.y + y;
+        uint8_t row = (arena_y >= 0 && arena_y < ARENA_HEIGHT) ? placed[arena_y] : 0;
+        int left = position.x + __builtin_ctz(shape->rows[y]);
+        int right = position.x + 31 - __builtin_clz(shape->rows[y]);
+        int free;
+        if (dx < 0) {
+            uint8_t blocks = row & ((1U << left) - 1);
+            free = blocks ? left - (31 - __builtin_clz(blocks)) - 1 : left;
+        } else {
+            uint8_t blocks = row & (uint8_t)~((2U << right) - 1);
+            free = blocks ? __builtin_ctz(blocks) - right - 1 : (int)ARENA_WIDTH - 1 - right;
+        }
+        distance = MIN(distance, free);
+    }
+    return distance;
+}
+//Advances a PCG32 generator and returns its next 32 random bits
+uint32_t Tetris_Random(uint64_t *rng){
+    uint64_t old = *rng;
+    *rng = old * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+//Random number in [0, n), scaled with a multiply instead of a biased modulo
+static uint8_t randomBelow(uint64_t *rng, uint32_t n){
+    return (uint8_t)(((uint64_t)Tetris_Random(rng) * n) >> 32);
+}
+//Draws one of the pieces still in the bag, starting a new bag of all seven once it is empty
+static uint8_t pickFromBag(TetrisState *state){
+    if (state->bag == 0) {
+        state->bag = (1U << PIECE_COUNT) - 1;
+    }
+    uint8_t skip = randomBelow(&state->rng, __builtin_popcount(state->bag));
+    uint8_t bag = state->bag;
+    while (skip--) {
+        bag &= bag - 1;
+    }
+    uint8_t type = (uint8_t)__builtin_ctz(bag);
+    state->bag &= ~(1U << type);
+    return type;
+}
+//Draws a piece, rerolling up to HISTORY_ROLLS times while it matches one of the last HISTORY_SIZE pieces
+static uint8_t pickFromHistory(TetrisState *state){
+    uint8_t type = 0;
+    for (uint8_t roll = 0; roll < HISTORY_ROLLS; ++roll) {
+        type = randomBelow(&state->rng, PIECE_COUNT);
+        if (!memchr(state->history, type, HISTORY_SIZE)) {
+            break;
+        }
+    }
+    memmove(state->history + 1, state->history, HISTORY_SIZE - 1);
+    state->history[0] = type;
+    return type;
+}
+//Selecting Random Tetromino with the match's randomizer
+uint8_t pickPiece(TetrisState *state){
+    switch (state->randomizer) {
+        case TETRIS_RANDOMIZER_BAG: return pickFromBag(state);
+        case TETRIS_RANDOMIZER_HISTORY: return pickFromHistory(state);
+        default: return randomBelow(&state->rng, PIECE_COUNT);
+    }
+}
+//Puts the next piece at the top of the arena and draws a new one for the end of the preview
+static void spawnPiece(TetrisState *state){
+    state->piece.type = state->next[0];
+    state->piece.rotation = 0;
+    memmove(state->next, state->next + 1, TETRIS_PREVIEW - 1);
+    state->next[TETRIS_PREVIEW - 1] = pickPiece(state);
+    state->position.x = getShape(state->piece)->spawn_x;
+    state->position.y = -1;
+    state->gravity_timer = 0;
+    state->pieces++;
+}
+//Number of ticks the piece waits before falling one row at the current level
+static uint8_t fallSpeed(uint8_t level){
+    return MAX(1, (int)FALL_SPEED - 2 * level);
+}
+//A piece locking at position ends the match: it came to rest too close to the top
+bool lockOut(Piece piece, Position position){
+    const Shape *shape = getShape(piece);
+    return position.y + shape->start_y - shape->h < 0;
+}
+//Rotates piece at *position in the arena placed, nudging it away from a wall it would otherwise poke through.
+//Leaves both unchanged and returns false if it does not fit
+bool rotateNudged(const uint8_t *placed, Piece *piece, Position *position){
+    Piece rotated = rotatePiece(*piece);
+    Position check = *position;
+    uint8_t collide = collisionCheck(placed, rotated, check);
+    if (collide == COLLIDE_LEFT) {
+        while (collide == COLLIDE_LEFT) {
+            check.x++;
+            collide = collisionCheck(placed, rotated, check);
+        }
+    } else if (collide == COLLIDE_RIGHT) {
+        while (collide == COLLIDE_RIGHT) {
+            check.x--;
+            collide = collisionCheck(placed, rotated, check);
+        }
+    }
+    if (collide != COLLIDE_NONE) {
+        return false;
+    }
+    *position = check;
+    *piece = rotated;
+    return true;
+}
+//Rotates the falling piece
+static bool rotate(TetrisState *state){
+    return rotateNudged(state->placed, &state->piece, &state->position);
+}
+//Moves the falling piece dx columns if nothing is in the way
+static bool shift(TetrisState *state, int dx){
+    Position check = {.x = (int8_t)(state->position.x + dx), .y = state->position.y};
+    if (collisionCheck(state->placed, state->piece, check)) {
+        return false;
+    }
+    state->position = check;
+    return true;
+}
+//Raises the column heights under a piece that was just added to the arena
+static void raiseHeights(TetrisState *state){
+    const Shape *shape = getShape(state->piece);
+    for (int x = 0; x < PIECE_WIDTH; ++x) {
+        for (int y = 0; y < PIECE_HEIGHT; ++y) {
+            int arena_y = state->position.y + y;
+            if ((shape->rows[y] & (1U << x)) && arena_y >= 0) {
+                uint8_t *height = &state->heights[state->position.x + x];
+                *height = MAX(*height, ARENA_HEIGHT - arena_y);
+                break;
+            }
+        }
+    }
+}
+//Lowers the column heights after lines rows were cleared. Every cleared row lies under the top of every column,
+//so each column sinks by lines, and further if its old top block was in a cleared row and uncovers a hole
+static void lowerHeights(TetrisState *state, uint8_t lines){
+    for (int x = 0; x < ARENA_WIDTH; ++x) {
+        uint8_t height = state->heights[x] - lines;
+        while (height > 0 && !(state->placed[ARENA_HEIGHT - height] & (1U << x))) {
+            height--;
+        }
+        state->heights[x] = height;
+    }
+}
+//Locks the falling piece, clears rows, scores them and spawns the next piece
+static uint16_t lockPiece(TetrisState *state){
+    uint16_t events = TETRIS_EVENT_LOCKED;
+    addToPlaced(state->placed, state->piece, state->position);
+    raiseHeights(state);
+    state->generation++;
+    if (lockOut(state->piece, state->position)) {
+        state->game_over = true;
+        return events | TETRIS_EVENT_GAME_OVER;
+    }
+    uint8_t lines = (uint8_t)__builtin_popcount(checkForRowClearing(state->placed));
+    state->lines_cleared = lines;
+    if (lines) {
+        lowerHeights(state, lines);
+        events |= TETRIS_EVENT_LINES;
+        state->total_rows_cleared += lines;
+        if (state->total_rows_cleared >= (uint32_t)(state->level + 1) * 10) {
+            state->level++;
+            events |= TETRIS_EVENT_LEVEL_UP;
+        }
+        state->score += findPoints(state->level, lines);
+    }
+    spawnPiece(state);
+    return events | TETRIS_EVENT_SPAWNED;
+}
+//Starts a new match on an empty arena. The same seed and randomizer always deal the same pieces
+void Tetris_Init(TetrisState *state, uint64_t seed, uint8_t randomizer){
+    memset(state, 0, sizeof(TetrisState));
+    state->das = DAS_MS;
+    state->arr = ARR_MS;
+    state->randomizer = randomizer < TETRIS_RANDOMIZER_COUNT ? randomizer : TETRIS_RANDOMIZER_BAG;
+    //PCG seeding: mix the seed in between two steps so nearby seeds still start far apart
+    Tetris_Random(&state->rng);
+    state->rng += seed;
+    Tetris_Random(&state->rng);
+    //Like TGM, the history starts full of S and Z so the first pieces are rarely the awkward ones
+    for (uint8_t i = 0; i < HISTORY_SIZE; ++i) {
+        state->history[i] = (i % 2) ? PIECE_S : PIECE_Z;
+    }
+    for (uint8_t i = 0; i < TETRIS_PREVIEW; ++i) {
+        state->next[i] = pickPiece(state);
+    }
+    spawnPiece(state);
+}
+//Game time in ms at which tick n ends
+static uint32_t tickTime(uint32_t n){
+    return (uint32_t)((uint64_t)n * 1000 / TETRIS_TICK_HZ);
+}
+//Game time in ms the match has been simulated up to
+uint32_t Tetris_Time(const TetrisState *state){
+    return tickTime(state->ticks);
+}
+//Performs every auto-repeat shift of the held direction that falls due up to time
+static uint16_t autoShift(TetrisState *state, uint32_t time){
+    uint16_t events = TETRIS_EVENT_NONE;
+    while (state->shift_dir != TETRIS_INPUT_NONE && state->shift_due <= time) {
+        int dx = state->shift_dir == TETRIS_INPUT_LEFT ? -1 : 1;
+        if (state->arr == 0) {
+            //shift_due stays in the past, so the piece keeps hugging the wall, new pieces included
+            int distance = slideDistance(state->placed, state->piece, state->position, dx);
+            if (distance > 0) {
+                state->position.x += dx * distance;
+                events |= TETRIS_EVENT_MOVED;
+            }
+            break;
+        }
+        if (shift(state, dx)) {
+            events |= TETRIS_EVENT_MOVED;
+        }
+        state->shift_due += state->arr;
+    }
+    return events;
+}
+//Row the falling piece comes to rest on if dropped straight down. While the piece is above the stack this
+//only needs the column heights and the piece's bottom profile; tucked under an overhang it steps down instead
+int Tetris_DropRow(const TetrisState *state){
+    const Shape *shape = getShape(state->piece);
+    int landing = ARENA_HEIGHT;
+    for (int x = 0; x < PIECE_WIDTH; ++x) {
+        if (shape->bottom[x] < 0) {
+            continue;
+        }
+        int top = ARENA_HEIGHT - state->heights[state->position.x + x];
+        landing = MIN(landing, top - 1 - shape->bottom[x]);
+    }
+    if (landing >= state->position.y) {
+        return landing;
+    }
+    Position check = state->position;
+    do {
+        check.y++;
+    } while (!collisionCheck(state->placed, state->piece, check));
+    return check.y - 1;
+}
+//Applies the one-shot actions in input (moves, rotation, then hard drop)
+static uint16_t applyInput(TetrisState *state, uint8_t input){
+    uint16_t events = TETRIS_EVENT_NONE;
+    if ((input & TETRIS_INPUT_RIGHT) && shift(state, 1)) {
+        events |= TETRIS_EVENT_MOVED;
+    }
+    if ((input & TETRIS_INPUT_LEFT) && shift(state, -1)) {
+        events |= TETRIS_EVENT_MOVED;
+    }
+    if ((input & TETRIS_INPUT_ROTATE) && rotate(state)) {
+        events |= TETRIS_EVENT_ROTATED;
+    }
+    if (input & TETRIS_INPUT_HARD_DROP) {
+        state->position.y = Tetris_DropRow(state);
+        events |= TETRIS_EVENT_HARD_DROP | lockPiece(state);
+    }
+    return events;
+}
+//Reports one key press or release that happened at game time `time` (ms), which is clamped to the tick
+//currently being built. Presses act immediately, so several actions between two ticks all happen, in the order
+//they are reported. Held actions stay in effect until released; held left/right auto-repeat after das ms,
+//every arr ms, with repeats landing at their exact times between ticks
+uint16_t Tetris_Input(TetrisState *state, uint8_t input, bool pressed, uint32_t time){
+    const uint8_t horizontal = TETRIS_INPUT_LEFT | TETRIS_INPUT_RIGHT;
+    if (state->game_over) {
+        state->held = pressed ? (state->held | input) : (state->held & ~input);
+        return TETRIS_EVENT_NONE;
+    }
+    time = MIN(MAX(time, Tetris_Time(state)), tickTime(state->ticks + 1));
+    uint16_t events = autoShift(state, time);
+    if (!pressed) {
+        state->held &= ~input;
+        if (input & state->shift_dir) {
+            state->shift_dir = state->held & horizontal;
+            state->shift_due = time + state->das;
+        }
+        return events;
+    }
+    state->held |= input;
+    if (input & horizontal) {
+        state->shift_dir = (input & TETRIS_INPUT_RIGHT) ? TETRIS_INPUT_RIGHT : TETRIS_INPUT_LEFT;
+        state->shift_due = time + state->das;
+    }
+    return events | applyInput(state, input);
+}
+//Advances the match by one tick: applies the input, then gravity. Returns the TETRIS_EVENT_* that happened.
+//input is for callers without press/release events; a SOFT_DROP bit there lasts for this tick only
+uint16_t Tetris_Step(TetrisState *state, uint8_t input){
+    if (state->game_over) {
+        return TETRIS_EVENT_NONE;
+    }
+    uint16_t events = applyInput(state, input);
+    if (state->game_over) {
+        return events;
+    }
+    events |= autoShift(state, tickTime(state->ticks + 1));
+    state->ticks++;
+    uint8_t fall_speed = ((input | state->held) & TETRIS_INPUT_SOFT_DROP) ? 1 : fallSpeed(state->level);
+    if (++state->gravity_timer >= fall_speed) {
+        state->gravity_timer = 0;
+        Position check = {.x = state->position.x, .y = (int8_t)(state->position.y + 1)};
+        if (!collisionCheck(state->placed, state->piece, check)) {
+            state->position = check;
+            events |= TETRIS_EVENT_FELL;
+        } else {
+            events |= lockPiece(state);
+        }
+    }
+    return events;
+}
+//Appends the low `bytes` bytes of value, least significant first
+static void putBytes(uint8_t **out, uint64_t value, int bytes){
+    for (int i = 0; i < bytes; ++i) {
+        *(*out)++ = (uint8_t)(value >> (8 * i));
+    }
+}
+//Reads a `bytes` wide little-endian value
+static uint64_t getBytes(const uint8_t **in, int bytes){
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= (uint64_t)*(*in)++ << (8 * i);
+    }
+    return value;
+}
+//Writes the state as TETRIS_SNAPSHOT_SIZE bytes that load back the same on any machine.
+//The column heights are left out, Tetris_Load measures them again from the arena
+void Tetris_Save(const TetrisState *state, uint8_t *out){
+    putBytes(&out, state->score, 8);
+    putBytes(&out, state->rng, 8);
+    putBytes(&out, state->total_rows_cleared, 4);
+    putBytes(&out, state->pieces, 4);
+    putBytes(&out, state->ticks, 4);
+    putBytes(&out, state->shift_due, 4);
+    memcpy(out, state->placed, ARENA_HEIGHT);
+    out += ARENA_HEIGHT;
+    memcpy(out, state->next, TETRIS_PREVIEW);
+    out += TETRIS_PREVIEW;
+    memcpy(out, state->history, HISTORY_SIZE);
+    out += HISTORY_SIZE;
+    const uint8_t bytes[] = {state->piece.type, state->piece.rotation, (uint8_t)state->position.x, (uint8_t)state->position.y,
+                             state->gravity_timer, state->level, state->lines_cleared, state->held, state->shift_dir, state->das,
+                             state->arr, state->randomizer, state->bag, state->game_over};
+    memcpy(out, bytes, sizeof(bytes));
+    out += sizeof(bytes);
+    putBytes(&out, state->generation, 2);
+}
+//Restores a state written by Tetris_Save. Returns false, leaving state unusable, if the bytes do not describe
+//a state the simulation could have reached
+bool Tetris_Load(TetrisState *state, const uint8_t *in){
+    memset(state, 0, sizeof(TetrisState));
+    state->score = getBytes(&in, 8);
+    state->rng = getBytes(&in, 8);
+    state->total_rows_cleared = (uint32_t)getBytes(&in, 4);
+    state->pieces = (uint32_t)getBytes(&in, 4);
+    state->ticks = (uint32_t)getBytes(&in, 4);
+    state->shift_due = (uint32_t)getBytes(&in, 4);
+    memcpy(state->placed, in, ARENA_HEIGHT);
+    in += ARENA_HEIGHT;
+    memcpy(state->next, in, TETRIS_PREVIEW);
+    in += TETRIS_PREVIEW;
+    memcpy(state->history, in, HISTORY_SIZE);
+    in += HISTORY_SIZE;
+    state->piece.type = *in++;
+    state->piece.rotation = *in++;
+    state->position.x = (int8_t)*in++;
+    state->position.y = (int8_t)*in++;
+    state->gravity_timer = *in++;
+    state->level = *in++;
+    state->lines_cleared = *in++;
+    state->held = *in++;
+    state->shift_dir = *in++;
+    state->das = *in++;
+    state->arr = *in++;
+    state->randomizer = *in++;
+    state->bag = *in++;
+    state->game_over = *in++ != 0;
+    state->generation = (uint16_t)getBytes(&in, 2);
+
+    bool valid = state->piece.type < PIECE_COUNT && state->piece.rotation < ROTATION_COUNT && state->lines_cleared <= 4 &&
+                 state->randomizer < TETRIS_RANDOMIZER_COUNT && state->bag < (1U << PIECE_COUNT) &&
+                 (state->shift_dir == TETRIS_INPUT_NONE || state->shift_dir == TETRIS_INPUT_LEFT || state->shift_dir == TETRIS_INPUT_RIGHT);
+    for (uint8_t i = 0; i < TETRIS_PREVIEW; ++i) {
+        valid = valid && state->next[i] < PIECE_COUNT;
+    }
+    for (uint8_t i = 0; i < HISTORY_SIZE; ++i) {
+        valid = valid && state->history[i] < PIECE_COUNT;
+    }
+    //The falling piece has to lie between the walls and above the floor, the simulation indexes columns by it
+    const uint8_t outside = COLLIDE_LEFT | COLLIDE_RIGHT | COLLIDE_BOTTOM;
+    if (!valid || (collisionCheck(state->placed, state->piece, state->position) & outside)) {
+        return false;
+    }
+    for (uint8_t x = 0; x < ARENA_WIDTH; ++x) {
+        uint8_t height = ARENA_HEIGHT;
+        while (height > 0 && !(state->placed[ARENA_HEIGHT - height] & (1U << x))) {
+            height--;
+        }
+        state->heights[x] = height;
+    }
+    return true;
+}
+//64-bit FNV-1a hash of the state's snapshot. Equal digests mean equal matches, whatever build or machine ran them
+uint64_t Tetris_Digest(const TetrisState *state){
+    uint8_t snapshot[TETRIS_SNAPSHOT_SIZE];
+    Tetris_Save(state, snapshot);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < TETRIS_SNAPSHOT_SIZE; ++i) {
+        hash ^= snapshot[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,119 @@
+//Headless Tetris simulation: arena, pieces and stepping, with no SDL dependency.
+//It is integer-only (the makefile builds it with -mgeneral-regs-only), so the same inputs give bit-identical
+//matches on every compiler, flag set and machine, which replay verification relies on
+#ifndef TETRIS_CORE_H
+#define TETRIS_CORE_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//Macro Definitions
+#define ARENA_WIDTH 8U
+#define ARENA_HEIGHT 18U
+#define ROW_FULL 0xFFU
+#define PIECE_WIDTH 4U
+#define PIECE_HEIGHT 4U
+#define ROTATION_COUNT 4U
+#define TETRIS_TICK_HZ 60U   // Tetris_Step calls per second of game time
+#define FALL_SPEED 30U       // ticks per row at level 0
+#define DAS_MS 167U          // default delay before a held left/right starts repeating
+#define ARR_MS 33U           // default time between repeats once it does; 0 slides straight to the wall
+#define TETRIS_RULES_VERSION 1U // bumped whenever a change alters how the same inputs play out, so old replays are refused
+#define TETRIS_PREVIEW 5U    // upcoming pieces kept in TetrisState.next
+#define HISTORY_SIZE 4U      // pieces the history randomizer remembers
+#define HISTORY_ROLLS 4U     // draws the history randomizer makes before accepting a repeat
+#define TETRIS_SNAPSHOT_SIZE 75U // bytes Tetris_Save writes
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+enum {PIECE_I, PIECE_J, PIECE_L, PIECE_O, PIECE_S, PIECE_T, PIECE_Z, PIECE_COUNT};
+enum {COLLIDE_NONE = 0, COLLIDE_LEFT = 1 << 0, COLLIDE_RIGHT = 1 << 1, COLLIDE_TOP = 1 << 2, COLLIDE_BOTTOM = 1 << 3, COLLIDE_PIECE = 1 << 4};
+//How the piece sequence is drawn: independent uniform picks, shuffled bags of all seven pieces, or uniform picks
+//rerolled when they repeat one of the last HISTORY_SIZE pieces (TGM style)
+enum {TETRIS_RANDOMIZER_UNIFORM, TETRIS_RANDOMIZER_BAG, TETRIS_RANDOMIZER_HISTORY, TETRIS_RANDOMIZER_COUNT};
+//Actions fed to Tetris_Step or Tetris_Input, combined as a bitmask. SOFT_DROP is a held action, the rest fire once
+enum {TETRIS_INPUT_NONE = 0, TETRIS_INPUT_LEFT = 1 << 0, TETRIS_INPUT_RIGHT = 1 << 1, TETRIS_INPUT_ROTATE = 1 << 2, TETRIS_INPUT_SOFT_DROP = 1 << 3, TETRIS_INPUT_HARD_DROP = 1 << 4};
+//What happened during a Tetris_Step or Tetris_Input, combined as a bitmask
+enum {TETRIS_EVENT_NONE = 0, TETRIS_EVENT_MOVED = 1 << 0, TETRIS_EVENT_ROTATED = 1 << 1, TETRIS_EVENT_FELL = 1 << 2, TETRIS_EVENT_LOCKED = 1 << 3,
+      TETRIS_EVENT_LINES = 1 << 4, TETRIS_EVENT_LEVEL_UP = 1 << 5, TETRIS_EVENT_SPAWNED = 1 << 6, TETRIS_EVENT_GAME_OVER = 1 << 7,
+      TETRIS_EVENT_HARD_DROP = 1 << 8};
+
+//Shape and bounding box of a single Tetris Piece in one rotation
+typedef struct Shape {
+    uint8_t rows[PIECE_HEIGHT];  // one bitmask per row of the 4x4 box
+    uint8_t w;
+    uint8_t h;
+    uint8_t start_x;
+    uint8_t start_y;
+    uint8_t spawn_x;             // arena column the piece enters at
+    int8_t bottom[PIECE_WIDTH];  // lowest occupied row of each column of the 4x4 box, -1 if the column is empty
+} Shape;
+//A falling piece is just its type and rotation; the cells come from the shape table
+typedef struct Piece {
+    uint8_t type;
+    uint8_t rotation;
+} Piece;
+//Arena coordinates of the top-left corner of a piece's 4x4 box
+typedef struct Position {
+    int8_t x;
+    int8_t y;
+} Position;
+//Everything needed to advance one match, independent of how it is shown.
+//There is no hidden or global state, the piece sequence included: it comes from a generator seeded per match,
+//so the same seed always deals the same pieces and a process can run as many matches side by side as it has
+//TetrisStates.
+//Fields are ordered widest first so the struct packs without holes
+typedef struct TetrisState {
+    uint64_t score;                // current score
+    uint64_t rng;                  // PCG32 state the piece sequence is drawn from
+    uint32_t total_rows_cleared;   // Tracks the total number of rows cleared
+    uint32_t pieces;               // number of pieces spawned so far
+    uint32_t ticks;                // Tetris_Step calls so far; game time is ticks / TETRIS_TICK_HZ seconds
+    uint32_t shift_due;            // game time (ms) of the next auto-repeat shift of shift_dir
+    uint8_t placed[ARENA_HEIGHT];  // One bitmask per arena row (8x18 blocks). Bit x is set when column x is occupied
+    uint8_t heights[ARENA_WIDTH];  // Filled height of each column: ARENA_HEIGHT minus the row of its topmost block, 0 if empty
+    uint8_t next[TETRIS_PREVIEW];  // types of the pieces that spawn after the falling one, soonest first
+    uint8_t history[HISTORY_SIZE]; // types of the most recently drawn pieces, newest first (history randomizer)
+    Piece piece;                   // the falling piece
+    Position position;             // where the falling piece is
+    uint16_t generation;           // bumped every time placed changes, so views can tell when to redraw it
+    uint8_t gravity_timer;         // ticks since the piece last fell
+    uint8_t level;                 // current level (affect the difficulty)
+    uint8_t lines_cleared;         // rows cleared by the most recent lock
+    uint8_t held;                  // TETRIS_INPUT_* currently held down, as reported through Tetris_Input; only ever change it
+                                   // through Tetris_Input (releases included), which keeps shift_dir and shift_due in step
+    uint8_t shift_dir;             // TETRIS_INPUT_LEFT or RIGHT while that key auto-repeats, else NONE
+    uint8_t das;                   // delayed auto shift in ms, DAS_MS unless changed after Tetris_Init
+    uint8_t arr;                   // auto repeat rate in ms, ARR_MS unless changed after Tetris_Init
+    uint8_t randomizer;            // TETRIS_RANDOMIZER_* dealing the pieces
+    uint8_t bag;                   // pieces left in the current bag, bit per type (bag randomizer)
+    bool game_over;
+} TetrisState;
+//A match used to fit in one 64 byte cache line. The seeded piece generator (rng, next, history, randomizer, bag)
+//pushed it to 85 bytes, and none of that can leave the state without breaking one-state-per-match, so the budget
+//is two lines; anything a view alone needs belongs outside this struct
+static_assert(sizeof(TetrisState) <= 2 * 64, "a match must fit in two cache lines");
+
+const Shape *getShape(Piece piece);
+Piece rotatePiece(Piece piece);
+bool rotateNudged(const uint8_t *placed, Piece *piece, Position *position);
+uint8_t shiftRow(uint8_t mask, int x);
+uint8_t collisionCheck(const uint8_t *placed, Piece piece, Position position);
+void addToPlaced(uint8_t *placed, Piece piece, Position position);
+bool lockOut(Piece piece, Position position);
+int slideDistance(const uint8_t *placed, Piece piece, Position position, int dx);
+uint32_t checkForRowClearing(uint8_t *placed);
+int findPoints(uint8_t level, uint8_t lines);
+uint32_t Tetris_Random(uint64_t *rng);
+uint8_t pickPiece(TetrisState *state);
+void Tetris_Init(TetrisState *state, uint64_t seed, uint8_t randomizer);
+uint32_t Tetris_Time(const TetrisState *state);
+int Tetris_DropRow(const TetrisState *state);
+uint16_t Tetris_Input(TetrisState *state, uint8_t input, bool pressed, uint32_t time);
+uint16_t Tetris_Step(TetrisState *state, uint8_t input);
+void Tetris_Save(const TetrisState *state, uint8_t *out);
+bool Tetris_Load(TetrisState *state, const uint8_t *in);
+uint64_t Tetris_Digest(const TetrisState *state);
+
+#endif
@@ -0,0 +1,273 @@
+//Preprocessor Directives
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+#include "tetris_corpus.h"
+
+//Reads a `bytes` wide little-endian value
+static uint64_t getLE(const uint8_t *data, int bytes){
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= (uint64_t)data[i] << (8 * i);
+    }
+    return value;
+}
+//Writes the low `bytes` bytes of value, least significant first
+static void putLE(uint8_t *data, uint64_t value, int bytes){
+    for (int i = 0; i < bytes; ++i) {
+        data[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+//Reads the footer ending at byte end of data into corpus: the blocks of a current corpus, or the one index of a
+//legacy one. Every field is checked against end before any sum is formed, so no corrupt value can wrap around
+static bool readFooter(Corpus *corpus, const uint8_t *data, size_t end){
+    if (end < CORPUS_FOOTER_SIZE) {
+        return false;
+    }
+    const uint8_t *footer = data + end - CORPUS_FOOTER_SIZE;
+    uint64_t table = getLE(footer, 8);
+    uint64_t count = getLE(footer + 8, 4);
+    uint64_t room = end - CORPUS_FOOTER_SIZE;
+    if (memcmp(footer + 12, CORPUS_LEGACY_MAGIC, 4) == 0) {
+        if (table > room || count > (room - table) / CORPUS_ENTRY_SIZE || table + count * CORPUS_ENTRY_SIZE != room) {
+            return false;
+        }
+        corpus->block_offsets[0] = table;
+        corpus->block_counts[0] = (uint32_t)count;
+        corpus->blocks = 1;
+        corpus->count = (uint32_t)count;
+        corpus->table = table;
+        corpus->end = end;
+        return true;
+    }
+    if (memcmp(footer + 12, CORPUS_MAGIC, 4) != 0 || table > room || count > CORPUS_MAX_BLOCKS ||
+        room - table != count * CORPUS_ENTRY_SIZE) {
+        return false;
+    }
+    uint64_t total = 0;
+    for (uint32_t b = 0; b < count; ++b) {
+        const uint8_t *entry = data + table + (size_t)b * CORPUS_ENTRY_SIZE;
+        uint64_t offset = getLE(entry, 8);
+        uint64_t entries = getLE(entry + 8, 4);
+        if (offset > table || entries > (table - offset) / CORPUS_ENTRY_SIZE) {
+            return false;
+        }
+        corpus->block_offsets[b] = offset;
+        corpus->block_counts[b] = (uint32_t)entries;
+        total += entries;
+    }
+    if (total > UINT32_MAX) {
+        return false;
+    }
+    corpus->blocks = (uint32_t)count;
+    corpus->count = (uint32_t)total;
+    corpus->table = table;
+    corpus->end = end;
+    return true;
+}
+//Offset just past the last corpus magic, current or legacy, that ends at or before end; 0 if there is none.
+//Both magics are the same three bytes and one more, so the window moves back by how far into a magic the byte at
+//its start could sit (four for a byte in neither), and only about one byte in four is read
+static size_t findMagic(const uint8_t *data, size_t end){
+    if (end < 4) {
+        return 0;
+    }
+    for (size_t at = end - 4;;) {
+        uint8_t byte = data[at];
+        size_t skip = 4;
+        if (byte == CORPUS_MAGIC[0] && memcmp(data + at, CORPUS_MAGIC, 3) == 0 &&
+            (data[at + 3] == CORPUS_MAGIC[3] || data[at + 3] == CORPUS_LEGACY_MAGIC[3])) {
+            return at + 4;
+        } else if (byte == CORPUS_MAGIC[1]) {
+            skip = 1;
+        } else if (byte == CORPUS_MAGIC[2]) {
+            skip = 2;
+        } else if (byte == CORPUS_MAGIC[3] || byte == CORPUS_LEGACY_MAGIC[3]) {
+            skip = 3;
+        }
+        if (at < skip) {
+            return 0;
+        }
+        at -= skip;
+    }
+}
+//Maps the corpus at path read-only, up to its last valid footer. Replays handed out by Corpus_Get point straight into the mapping
+bool Corpus_Open(Corpus *corpus, const char *path){
+    memset(corpus, 0, sizeof(Corpus));
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return false;
+    }
+    const uint8_t *data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+    corpus->mapping = mapping;
+    corpus->size = (size_t)file_size.QuadPart;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    close(file);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    corpus->size = (size_t)info.st_size;
+#endif
+    corpus->data = (const uint8_t *)data;
+    //Anything after the last valid footer is an append that never finished. A footer can only end where a magic does
+    size_t end = findMagic(corpus->data, corpus->size);
+    for (; end >= CORPUS_FOOTER_SIZE; end = findMagic(corpus->data, end - 1)) {
+        if (readFooter(corpus, corpus->data, end)) {
+            return true;
+        }
+    }
+    Corpus_Close(corpus);
+    return false;
+}
+//Unmaps the corpus; replays from Corpus_Get are invalid afterwards
+void Corpus_Close(Corpus *corpus){
+    if (corpus->data != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(corpus->data);
+        CloseHandle((HANDLE)corpus->mapping);
+#else
+        munmap((void *)corpus->data, corpus->size);
+#endif
+    }
+    memset(corpus, 0, sizeof(Corpus));
+}
+//Finds replay i without copying it. Fails if its entry points outside the replay area
+bool Corpus_Get(const Corpus *corpus, uint32_t i, const uint8_t **replay, size_t *size){
+    if (i >= corpus->count) {
+        return false;
+    }
+    uint32_t b = 0;
+    while (i >= corpus->block_counts[b]) {
+        i -= corpus->block_counts[b++];
+    }
+    const uint8_t *entry = corpus->data + corpus->block_offsets[b] + (size_t)i * CORPUS_ENTRY_SIZE;
+    uint64_t offset = getLE(entry, 8);
+    uint64_t length = getLE(entry + 8, 4);
+    if (offset > corpus->table || length > corpus->table - offset) {
+        return false;
+    }
+    *replay = corpus->data + offset;
+    *size = (size_t)length;
+    return true;
+}
+//Makes the file's contents up to now durable, so a footer is never on disk ahead of what it points at
+static bool syncFile(FILE *file){
+#ifdef _WIN32
+    return fflush(file) == 0 && _commit(_fileno(file)) == 0;
+#else
+    return fflush(file) == 0 && fsync(fileno(file)) == 0;
+#endif
+}
+//Cuts the file back to size bytes
+static bool truncateFile(FILE *file, uint64_t size){
+#ifdef _WIN32
+    return fflush(file) == 0 && _chsize_s(_fileno(file), (int64_t)size) == 0;
+#else
+    return fflush(file) == 0 && ftruncate(fileno(file), (off_t)size) == 0;
+#endif
+}
+//Adds a replay to the end of the corpus at path, creating the file if it does not exist or is empty. Nothing
+//before the last valid footer is written to: the replay, the merged index block, the block table and the footer
+//all go after it, the footer last once the rest is on disk. Fails on a file that holds no valid corpus
+bool Corpus_Append(const char *path, const uint8_t *replay, size_t size){
+    if (size > UINT32_MAX) {
+        return false;
+    }
+    FILE *file = fopen(path, "rb");
+    bool fresh = file == NULL;
+    if (file != NULL) {
+        fresh = fseek64(file, 0, SEEK_END) == 0 && ftell64(file) == 0;
+        fclose(file);
+    }
+    Corpus corpus;
+    memset(&corpus, 0, sizeof(Corpus));
+    if (!fresh && !Corpus_Open(&corpus, path)) {
+        return false;
+    }
+    if (corpus.count == UINT32_MAX) {
+        Corpus_Close(&corpus);
+        return false;
+    }
+    //The new block takes over the newest blocks no bigger than it, like the carries of a binary counter
+    uint32_t keep = corpus.blocks;
+    uint32_t entries = 1;
+    while (keep > 0 && (corpus.block_counts[keep - 1] <= entries || keep >= CORPUS_MAX_BLOCKS)) {
+        entries += corpus.block_counts[--keep];
+    }
+    uint64_t end = corpus.end;
+    uint64_t block = end + size;
+    uint64_t table = block + (uint64_t)entries * CORPUS_ENTRY_SIZE;
+    size_t tail_size = (size_t)entries * CORPUS_ENTRY_SIZE + (keep + 1) * CORPUS_ENTRY_SIZE;
+    uint8_t *tail = (uint8_t *)malloc(tail_size);
+    if (tail == NULL) {
+        Corpus_Close(&corpus);
+        return false;
+    }
+    uint8_t *write = tail;
+    for (uint32_t b = keep; b < corpus.blocks; ++b) {
+        size_t bytes = (size_t)corpus.block_counts[b] * CORPUS_ENTRY_SIZE;
+        memcpy(write, corpus.data + corpus.block_offsets[b], bytes);
+        write += bytes;
+    }
+    putLE(write, end, 8);
+    putLE(write + 8, size, 4);
+    write += CORPUS_ENTRY_SIZE;
+    for (uint32_t b = 0; b <= keep; ++b, write += CORPUS_ENTRY_SIZE) {
+        putLE(write, b < keep ? corpus.block_offsets[b] : block, 8);
+        putLE(write + 8, b < keep ? corpus.block_counts[b] : entries, 4);
+    }
+    Corpus_Close(&corpus);
+    uint8_t footer[CORPUS_FOOTER_SIZE];
+    putLE(footer, table, 8);
+    putLE(footer + 8, keep + 1, 4);
+    memcpy(footer + 12, CORPUS_MAGIC, 4);
+    //Drop the leftovers of an append that never finished, then write everything but the footer and wait for it
+    file = fopen(path, fresh ? "w+b" : "r+b");
+    bool ok = file != NULL && truncateFile(file, end) && fseek64(file, (int64_t)end, SEEK_SET) == 0 &&
+              fwrite(replay, 1, size, file) == size && fwrite(tail, 1, tail_size, file) == tail_size &&
+              syncFile(file) && fwrite(footer, 1, CORPUS_FOOTER_SIZE, file) == CORPUS_FOOTER_SIZE && syncFile(file);
+    free(tail);
+    if (file == NULL) {
+        return false;
+    }
+    if (!ok) {
+        truncateFile(file, end);
+    }
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,41 @@
+//Archive of many replays in one file, read through a memory mapping
+#ifndef TETRIS_CORPUS_H
+#define TETRIS_CORPUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//Macro Definitions
+#define CORPUS_MAGIC "TCR2"
+#define CORPUS_LEGACY_MAGIC "TCRP"   // a single flat index; still read, and appended to in the current layout
+#define CORPUS_FOOTER_SIZE 16U       // block table offset (8 bytes), block count (4), CORPUS_MAGIC
+#define CORPUS_ENTRY_SIZE 12U        // offset (8 bytes) and size (4) of one replay, or of one index block
+#define CORPUS_MAX_BLOCKS 48U        // index blocks a corpus may have; appends keep it near log2 of the replay count
+
+//A corpus file only ever grows. Each append writes, after the footer of the one before:
+//the replay; a new index block (entries of replays in the order they were added); the block table (offset and
+//entry count of every live block, oldest first); and a footer pointing at the table. The new block holds the new
+//entry plus the entries of the newest blocks no bigger than it, so blocks roughly double in size going back and an
+//append copies O(log n) entries; the blocks it replaces, and the old table and footer, become dead space.
+//The last valid footer is the corpus: a torn append leaves the one before it intact, and it is found by searching
+//back from the end for a magic. A legacy corpus (CORPUS_LEGACY_MAGIC: index offset (8), replay count (4)) reads as
+//a single block. All multi-byte fields are little endian
+typedef struct Corpus {
+    const uint8_t *data;                         // the whole file, mapped read-only
+    size_t size;
+    size_t end;                                  // bytes up to the end of the last valid footer
+    uint64_t table;                              // offset of the block table; replays and blocks all lie before it
+    uint64_t block_offsets[CORPUS_MAX_BLOCKS];   // where each index block is, oldest first
+    uint32_t block_counts[CORPUS_MAX_BLOCKS];    // entries in each
+    uint32_t blocks;
+    uint32_t count;                              // replays in the corpus
+    void *mapping;                               // platform handle of the mapping (Windows only)
+} Corpus;
+
+bool Corpus_Open(Corpus *corpus, const char *path);
+void Corpus_Close(Corpus *corpus);
+bool Corpus_Get(const Corpus *corpus, uint32_t i, const uint8_t **replay, size_t *size);
+bool Corpus_Append(const char *path, const uint8_t *replay, size_t size);
+
+#endif
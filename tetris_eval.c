@@ -0,0 +1,176 @@
+//Preprocessor Directives
+#include <string.h>
+#include "tetris_eval.h"
+
+//Macro Definitions
+#define LANES 0x0101010101010101ULL   // the low bit of every byte of a word
+#define WELL_PLANES 5                 // bits of a bit-sliced well depth counter, enough for ARENA_HEIGHT
+
+//Batches load 8 boards' rows as one word, board i landing in bits 8i to 8i+7
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "batch evaluation assumes a little-endian machine");
+
+//Pierre Dellacherie's features with the weights El-Tetris tuned for them, times 100 (landing height is in half
+//rows, so its weight is halved). Aggregate height and bumpiness are left out, they only double count the rest
+const EvalWeights Eval_DefaultWeights = {{0, -790, 0, -339, -322, -935, -225, 342}};
+
+//Number of set bits in the low byte of x. Inline, as without -mpopcnt __builtin_popcount is a library call
+static int rowCount(uint32_t x){
+    x &= ROW_FULL;
+    x -= (x >> 1) & 0x55;
+    x = (x & 0x33) + ((x >> 2) & 0x33);
+    return (int)((x + (x >> 4)) & 0x0F);
+}
+//Copies placed to after with move locked in and its rows cleared, and works out the two features that depend on
+//the move rather than the board. Returns false if the lock would end the match
+bool Eval_Place(const uint8_t *placed, Move move, uint8_t *after, uint8_t *landing, uint8_t *eroded){
+    if (lockOut(move.piece, move.position)) {
+        return false;
+    }
+    const Shape *shape = getShape(move.piece);
+    int top = move.position.y + shape->start_y;
+    memcpy(after, placed, ARENA_HEIGHT);
+    addToPlaced(after, move.piece, move.position);
+    uint32_t cleared = checkForRowClearing(after);
+    //Cells of the piece that went with the cleared rows, times the number of rows
+    int cells = 0;
+    for (int y = 0; y < shape->h; ++y) {
+        if (cleared & 1UL << (top + y)) {
+            cells += rowCount(shape->rows[shape->start_y + y]);
+        }
+    }
+    *landing = (uint8_t)(2 * (ARENA_HEIGHT - top) - shape->h);
+    *eroded = (uint8_t)(__builtin_popcount(cleared) * cells);
+    return true;
+}
+//Fills features (EVAL_FEATURE_COUNT of them) for the arena placed. Everything is counted a row at a time from
+//the top with bit operations: cover holds the columns that have a block in or above the current row
+void Eval_Features(const uint8_t *placed, uint8_t landing, uint8_t eroded, int32_t *features){
+    memset(features, 0, EVAL_FEATURE_COUNT * sizeof(int32_t));
+    uint32_t cover = 0;
+    uint32_t above = 0;
+    uint32_t depth[WELL_PLANES] = {0};   // bit-sliced depth of the well each column is in
+    for (int y = 0; y < ARENA_HEIGHT; ++y) {
+        uint32_t row = placed[y];
+        cover |= row;
+        //Covered columns add a row of height each; neighbours differ in height by the rows only one covers
+        features[EVAL_AGGREGATE_HEIGHT] += rowCount(cover);
+        features[EVAL_HOLES] += rowCount(cover & ~row);
+        features[EVAL_BUMPINESS] += rowCount((cover ^ cover >> 1) & 0x7F);
+        //The walls count as filled; rows above the stack are not counted
+        if (cover) {
+            features[EVAL_ROW_TRANSITIONS] += rowCount((row ^ row >> 1) & 0x7F) + rowCount(~row & 0x81);
+        }
+        features[EVAL_COLUMN_TRANSITIONS] += rowCount(row ^ above);
+        above = row;
+        //Well cells are open from above with both neighbours filled; each adds its depth into the well
+        uint32_t well = ~cover & (row << 1 | 0x01) & (row >> 1 | 0x80) & ROW_FULL;
+        uint32_t carry = well;
+        for (int k = 0; k < WELL_PLANES; ++k) {
+            uint32_t next = depth[k] & carry;
+            depth[k] = (depth[k] ^ carry) & well;
+            carry = next;
+            features[EVAL_WELLS] += rowCount(depth[k]) << k;
+        }
+    }
+    //The floor counts as filled
+    features[EVAL_COLUMN_TRANSITIONS] += rowCount(~above);
+    features[EVAL_LANDING_HEIGHT] = landing;
+    features[EVAL_ERODED_CELLS] = eroded;
+}
+//Weighted sum of the features of placed
+int32_t Eval_Score(const uint8_t *placed, uint8_t landing, uint8_t eroded, const EvalWeights *weights){
+    int32_t features[EVAL_FEATURE_COUNT];
+    Eval_Features(placed, landing, eroded, features);
+    int32_t score = 0;
+    for (int f = 0; f < EVAL_FEATURE_COUNT; ++f) {
+        score += weights->weights[f] * features[f];
+    }
+    return score;
+}
+//Adds the arena placed with move locked in to batch. Returns its index, or -1 if the batch is full or the lock
+//would end the match
+int Eval_BatchAdd(EvalBatch *batch, const uint8_t *placed, Move move){
+    if (batch->count >= EVAL_BATCH) {
+        return -1;
+    }
+    uint32_t i = batch->count;
+    uint8_t after[ARENA_HEIGHT];
+    if (!Eval_Place(placed, move, after, &batch->landing[i], &batch->eroded[i])) {
+        return -1;
+    }
+    for (int y = 0; y < ARENA_HEIGHT; ++y) {
+        batch->rows[y][i] = after[y];
+    }
+    batch->count++;
+    return (int)i;
+}
+//Number of set bits in each byte of x
+static uint64_t bytePopcount(uint64_t x){
+    x -= (x >> 1) & 0x55 * LANES;
+    x = (x & 0x33 * LANES) + ((x >> 2) & 0x33 * LANES);
+    return (x + (x >> 4)) & 0x0F * LANES;
+}
+//Features of 8 boards at once, one board per byte of each word
+typedef struct LaneFeatures {
+    uint64_t height;
+    uint64_t holes;
+    uint64_t bumpiness;
+    uint64_t row_transitions;
+    uint64_t column_transitions;
+    uint64_t wells_even;   // well sums outgrow a byte, so they add up in the 16-bit halves of two words
+    uint64_t wells_odd;
+} LaneFeatures;
+
+//Eval_Features for the 8 boards from first on, whose rows are the bytes of the words at rows[y] + first.
+//Mirrors Eval_Features line by line, with shifts kept inside each byte
+static void batchFeatures(const uint8_t (*rows)[EVAL_BATCH], uint32_t first, LaneFeatures *features){
+    uint64_t cover = 0;
+    uint64_t above = 0;
+    uint64_t depth[WELL_PLANES] = {0};
+    memset(features, 0, sizeof(LaneFeatures));
+    for (int y = 0; y < ARENA_HEIGHT; ++y) {
+        uint64_t row;
+        memcpy(&row, &rows[y][first], sizeof(row));
+        cover |= row;
+        features->height += bytePopcount(cover);
+        features->holes += bytePopcount(cover & ~row);
+        features->bumpiness += bytePopcount((cover ^ cover >> 1) & 0x7F * LANES);
+        //0xFF in the bytes where cover is not zero
+        uint64_t stacked = (((cover & 0x7F * LANES) + 0x7F * LANES) | cover) & 0x80 * LANES;
+        stacked = (stacked >> 7) * 0xFF;
+        features->row_transitions += (bytePopcount((row ^ row >> 1) & 0x7F * LANES) + bytePopcount(~row & 0x81 * LANES)) & stacked;
+        features->column_transitions += bytePopcount(row ^ above);
+        above = row;
+        uint64_t well = ~cover & ((row << 1 & 0xFE * LANES) | LANES) & ((row >> 1 & 0x7F * LANES) | 0x80 * LANES);
+        uint64_t carry = well;
+        uint64_t wells = 0;
+        for (int k = 0; k < WELL_PLANES; ++k) {
+            uint64_t next = depth[k] & carry;
+            depth[k] = (depth[k] ^ carry) & well;
+            carry = next;
+            wells += bytePopcount(depth[k]) << k;
+        }
+        features->wells_even += wells & 0x00FF00FF00FF00FFULL;
+        features->wells_odd += wells >> 8 & 0x00FF00FF00FF00FFULL;
+    }
+    features->column_transitions += bytePopcount(~above);
+}
+//Scores every candidate in batch into scores, the same as Eval_Score would one at a time but 8 boards per pass
+void Eval_BatchScore(const EvalBatch *batch, const EvalWeights *weights, int32_t *scores){
+    const int32_t *w = weights->weights;
+    for (uint32_t first = 0; first < batch->count; first += 8) {
+        LaneFeatures features;
+        batchFeatures(batch->rows, first, &features);
+        for (uint32_t i = 0; i < 8 && first + i < batch->count; ++i) {
+            uint64_t wells = (i % 2 ? features.wells_odd : features.wells_even) >> (16 * (i / 2));
+            scores[first + i] = w[EVAL_AGGREGATE_HEIGHT] * (int32_t)(features.height >> (8 * i) & 0xFF) +
+                                w[EVAL_HOLES] * (int32_t)(features.holes >> (8 * i) & 0xFF) +
+                                w[EVAL_BUMPINESS] * (int32_t)(features.bumpiness >> (8 * i) & 0xFF) +
+                                w[EVAL_WELLS] * (int32_t)(wells & 0xFFFF) +
+                                w[EVAL_ROW_TRANSITIONS] * (int32_t)(features.row_transitions >> (8 * i) & 0xFF) +
+                                w[EVAL_COLUMN_TRANSITIONS] * (int32_t)(features.column_transitions >> (8 * i) & 0xFF) +
+                                w[EVAL_LANDING_HEIGHT] * (int32_t)batch->landing[first + i] +
+                                w[EVAL_ERODED_CELLS] * (int32_t)batch->eroded[first + i];
+        }
+    }
+}
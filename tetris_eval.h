@@ -0,0 +1,36 @@
+//Board evaluation for bots: the classic hand-tuned features of an arena and a weighted score, one board at a time
+//or a batch of candidate placements at once
+#ifndef TETRIS_EVAL_H
+#define TETRIS_EVAL_H
+
+#include "tetris_moves.h"
+
+//Macro Definitions
+#define EVAL_BATCH 64U   // candidates an EvalBatch holds; scored 8 at a time, one board per byte of a 64-bit word
+
+//Features, in the order of EvalWeights. Landing height is in half rows, measured to the middle of the piece
+enum {EVAL_AGGREGATE_HEIGHT, EVAL_HOLES, EVAL_BUMPINESS, EVAL_WELLS, EVAL_ROW_TRANSITIONS, EVAL_COLUMN_TRANSITIONS,
+      EVAL_LANDING_HEIGHT, EVAL_ERODED_CELLS, EVAL_FEATURE_COUNT};
+
+//Weight of every feature; a board scores the weighted sum, higher is better
+typedef struct EvalWeights {
+    int32_t weights[EVAL_FEATURE_COUNT];
+} EvalWeights;
+//Candidate placements waiting to be scored, stored column-major (row y of candidate i at rows[y][i]) so the
+//same row of 8 candidates is one 64-bit load
+typedef struct EvalBatch {
+    uint8_t rows[ARENA_HEIGHT][EVAL_BATCH];   // arena after the placement and its line clears
+    uint8_t landing[EVAL_BATCH];              // EVAL_LANDING_HEIGHT of each candidate
+    uint8_t eroded[EVAL_BATCH];               // EVAL_ERODED_CELLS of each candidate
+    uint32_t count;
+} EvalBatch;
+
+extern const EvalWeights Eval_DefaultWeights;
+
+bool Eval_Place(const uint8_t *placed, Move move, uint8_t *after, uint8_t *landing, uint8_t *eroded);
+void Eval_Features(const uint8_t *placed, uint8_t landing, uint8_t eroded, int32_t *features);
+int32_t Eval_Score(const uint8_t *placed, uint8_t landing, uint8_t eroded, const EvalWeights *weights);
+int Eval_BatchAdd(EvalBatch *batch, const uint8_t *placed, Move move);
+void Eval_BatchScore(const EvalBatch *batch, const EvalWeights *weights, int32_t *scores);
+
+#endif
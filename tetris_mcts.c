@@ -0,0 +1,256 @@
+//Preprocessor Directives
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tetris_mcts.h"
+
+//Nodes are cache line sized, so threads updating neighbouring nodes do not share lines
+static_assert(sizeof(MctsNode) == STEAL_CACHE_LINE, "a tree node should fill one cache line");
+
+//Nanoseconds on a monotonic clock
+static uint64_t nowNs(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+}
+//Sets up a search on pool's workers, or on the calling thread if pool is NULL. seed varies the pieces the
+//rollouts are dealt. All the memory the search needs is allocated here
+bool Mcts_Init(Mcts *mcts, StealPool *pool, uint64_t seed){
+    memset(mcts, 0, sizeof(Mcts));
+    mcts->pool = pool;
+    mcts->weights = Eval_DefaultWeights;
+    int workers = pool != NULL ? pool->count : 1;
+    mcts->memory = malloc(MCTS_MAX_NODES * sizeof(MctsNode) + STEAL_CACHE_LINE);
+    mcts->workers = (MctsWorker *)calloc(workers, sizeof(MctsWorker));
+    if (mcts->memory == NULL || mcts->workers == NULL) {
+        Mcts_Free(mcts);
+        return false;
+    }
+    mcts->nodes = (MctsNode *)(((uintptr_t)mcts->memory + STEAL_CACHE_LINE - 1) & ~(uintptr_t)(STEAL_CACHE_LINE - 1));
+    for (int i = 0; i < workers; ++i) {
+        MctsWorker *worker = &mcts->workers[i];
+        worker->rng = seed ^ 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+        //Rollouts place each piece where the evaluator likes it best, without lookahead
+        if (!Bot_Init(&worker->rollout, NULL, 1, 1)) {
+            Mcts_Free(mcts);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < POOL_MAX_THREADS * MCTS_TASKS_PER_WORKER; ++i) {
+        mcts->tasks[i].mcts = mcts;
+    }
+    return true;
+}
+void Mcts_Free(Mcts *mcts){
+    int workers = mcts->pool != NULL ? mcts->pool->count : 1;
+    for (int i = 0; mcts->workers != NULL && i < workers; ++i) {
+        Bot_Free(&mcts->workers[i].rollout);
+    }
+    free(mcts->memory);
+    free(mcts->workers);
+    mcts->memory = NULL;
+    mcts->nodes = NULL;
+    mcts->workers = NULL;
+}
+//Value in [0, 1] of where a rollout ended: 0 if the match was lost, otherwise a logistic of how much the arena
+//and the lines cleared improved on the root
+static double rolloutValue(const Mcts *mcts, const TetrisState *sim){
+    if (sim->game_over) {
+        return 0;
+    }
+    int32_t lines = (int32_t)(sim->total_rows_cleared - mcts->root.total_rows_cleared);
+    int32_t gain = Eval_Score(sim->placed, 0, 0, &mcts->weights) - mcts->root_score + MCTS_LINE_VALUE * lines;
+    return 1 / (1 + exp(-gain / MCTS_VALUE_SCALE));
+}
+//Plays the rest of a rollout from sim with the greedy player and returns its value
+static double rollout(const Mcts *mcts, MctsWorker *worker, TetrisState *sim){
+    for (uint32_t p = 0; p < MCTS_ROLLOUT_PIECES && !sim->game_over; ++p) {
+        Move move;
+        if (!Bot_Choose(&worker->rollout, sim, &move)) {
+            return 0;
+        }
+        Bot_Play(sim, move);
+    }
+    return rolloutValue(mcts, sim);
+}
+//Gives node children for the piece falling in sim: its MCTS_MAX_CHILDREN best placements by the evaluator, best
+//first, so unvisited ones are tried in that order. The caller has claimed the expansion. Marks the node full,
+//before doing any of the work if it can already tell, when the tree has no room for the children
+static void expand(Mcts *mcts, MctsWorker *worker, MctsNode *node, const TetrisState *sim){
+    uint8_t type = sim->piece.type;
+    uint32_t children = __atomic_load_n(&mcts->node_count, __ATOMIC_RELAXED);
+    if (children + MCTS_MAX_CHILDREN > MCTS_MAX_NODES) {
+        __atomic_store_n(&node->expanded[type], MCTS_FULL, __ATOMIC_RELEASE);
+        return;
+    }
+    Move best[MCTS_MAX_CHILDREN];
+    int32_t best_scores[MCTS_MAX_CHILDREN];
+    uint32_t kept = 0;
+    int count = Moves_Generate(sim->placed, sim->piece, sim->position, worker->moves);
+    for (int first = 0; first < count; first += EVAL_BATCH) {
+        uint16_t index[EVAL_BATCH];
+        worker->batch.count = 0;
+        for (int m = first; m < count && m < first + (int)EVAL_BATCH; ++m) {
+            int i = Eval_BatchAdd(&worker->batch, sim->placed, worker->moves[m]);
+            if (i >= 0) {
+                index[i] = (uint16_t)m;
+            }
+        }
+        Eval_BatchScore(&worker->batch, &mcts->weights, worker->scores);
+        //Insertion into the short sorted list of the best so far
+        for (uint32_t i = 0; i < worker->batch.count; ++i) {
+            uint32_t at = kept < MCTS_MAX_CHILDREN ? kept++ : MCTS_MAX_CHILDREN;
+            while (at > 0 && best_scores[at - 1] < worker->scores[i]) {
+                if (at < MCTS_MAX_CHILDREN) {
+                    best[at] = best[at - 1];
+                    best_scores[at] = best_scores[at - 1];
+                }
+                at--;
+            }
+            if (at < MCTS_MAX_CHILDREN) {
+                best[at] = worker->moves[index[i]];
+                best_scores[at] = worker->scores[i];
+            }
+        }
+    }
+    //Other threads may have taken the room since; node_count never goes past MCTS_MAX_NODES
+    do {
+        if (children + kept > MCTS_MAX_NODES) {
+            __atomic_store_n(&node->expanded[type], MCTS_FULL, __ATOMIC_RELEASE);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&mcts->node_count, &children, children + kept, true, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+    for (uint32_t i = 0; i < kept; ++i) {
+        MctsNode *child = &mcts->nodes[children + i];
+        memset(child, 0, sizeof(MctsNode));
+        child->move = best[i];
+    }
+    node->first[type] = children;
+    node->count[type] = (uint8_t)kept;
+    __atomic_store_n(&node->expanded[type], MCTS_EXPANDED, __ATOMIC_RELEASE);
+}
+//Child of node for piece type with the best upper confidence bound. Visits in flight count as losses, which
+//steers the other threads' descents elsewhere
+static uint32_t selectChild(const Mcts *mcts, const MctsNode *node, uint8_t type){
+    double log_visits = log((double)__atomic_load_n(&node->visits, __ATOMIC_RELAXED) + 1);
+    uint32_t best = node->first[type];
+    double best_bound = -1;
+    for (uint32_t i = node->first[type]; i < node->first[type] + node->count[type]; ++i) {
+        const MctsNode *child = &mcts->nodes[i];
+        uint32_t visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+        if (visits == 0) {
+            return i;
+        }
+        double mean = (double)__atomic_load_n(&child->value, __ATOMIC_RELAXED) / MCTS_VALUE_ONE / visits;
+        double bound = mean + MCTS_EXPLORATION * sqrt(log_visits / visits);
+        if (bound > best_bound) {
+            best_bound = bound;
+            best = i;
+        }
+    }
+    return best;
+}
+//One iteration: deals the unknown pieces from a fresh seed, descends the tree with virtual loss, expands the node
+//it stops at, plays a rollout from there and adds its value to every node on the way
+static void iterate(Mcts *mcts, MctsWorker *worker){
+    TetrisState sim = mcts->root;
+    sim.rng = (uint64_t)Tetris_Random(&worker->rng) << 32 | Tetris_Random(&worker->rng);
+    uint32_t depth = 0;
+    bool lost = false;
+    worker->path[0] = 0;
+    __atomic_add_fetch(&mcts->nodes[0].visits, MCTS_VIRTUAL_LOSS, __ATOMIC_RELAXED);
+    while (depth < MCTS_MAX_DEPTH && !sim.game_over) {
+        MctsNode *node = &mcts->nodes[worker->path[depth]];
+        uint8_t type = sim.piece.type;
+        uint8_t expanded = __atomic_load_n(&node->expanded[type], __ATOMIC_ACQUIRE);
+        if (expanded == MCTS_UNEXPANDED) {
+            uint8_t claim = MCTS_UNEXPANDED;
+            if (__atomic_compare_exchange_n(&node->expanded[type], &claim, MCTS_EXPANDING, false, __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                expand(mcts, worker, node, &sim);
+            }
+            break;
+        }
+        //Another thread is expanding it, or the tree has no room for its children: roll out from here
+        if (expanded == MCTS_EXPANDING || expanded == MCTS_FULL) {
+            break;
+        }
+        //Every placement of this piece ends the match
+        if (node->count[type] == 0) {
+            lost = true;
+            break;
+        }
+        //Children were generated for this same arena and piece, reached through the same placements
+        uint32_t child = selectChild(mcts, node, type);
+        Bot_Play(&sim, mcts->nodes[child].move);
+        __atomic_add_fetch(&mcts->nodes[child].visits, MCTS_VIRTUAL_LOSS, __ATOMIC_RELAXED);
+        worker->path[++depth] = child;
+    }
+    double value = lost ? 0 : rollout(mcts, worker, &sim);
+    int64_t fixed = (int64_t)(value * MCTS_VALUE_ONE);
+    for (uint32_t d = 0; d <= depth; ++d) {
+        MctsNode *node = &mcts->nodes[worker->path[d]];
+        __atomic_add_fetch(&node->value, fixed, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&node->visits, MCTS_VIRTUAL_LOSS - 1, __ATOMIC_RELAXED);
+    }
+    worker->iterations++;
+}
+//Pool task: a batch of iterations, then the task queues itself again on the same worker until the deadline.
+//Workers whose own tasks finish early steal the others'
+static void searchTask(void *arg, int worker){
+    MctsTask *task = (MctsTask *)arg;
+    Mcts *mcts = task->mcts;
+    for (uint32_t i = 0; i < MCTS_BATCH && nowNs() < mcts->deadline; ++i) {
+        iterate(mcts, &mcts->workers[worker]);
+    }
+    if (nowNs() < mcts->deadline) {
+        StealPool_Submit(mcts->pool, searchTask, task);
+    }
+}
+//Searches the match in state for about budget_ms and picks the placement of the falling piece whose rollouts
+//went best (the most visited one). Also leaves the expected value of the position in mcts->value and the number
+//of iterations in mcts->iterations. Fails only if every placement ends the match
+bool Mcts_Search(Mcts *mcts, const TetrisState *state, uint32_t budget_ms, Move *move){
+    int workers = mcts->pool != NULL ? mcts->pool->count : 1;
+    mcts->root = *state;
+    mcts->root_score = Eval_Score(state->placed, 0, 0, &mcts->weights);
+    memset(&mcts->nodes[0], 0, sizeof(MctsNode));
+    mcts->node_count = 1;
+    for (int i = 0; i < workers; ++i) {
+        mcts->workers[i].iterations = 0;
+    }
+    mcts->deadline = nowNs() + (uint64_t)budget_ms * 1000000;
+    //The first iteration expands the root, so there is a move to return however short the budget
+    iterate(mcts, &mcts->workers[0]);
+    if (mcts->pool != NULL) {
+        for (uint32_t i = 0; i < (uint32_t)workers * MCTS_TASKS_PER_WORKER; ++i) {
+            StealPool_Submit(mcts->pool, searchTask, &mcts->tasks[i]);
+        }
+        StealPool_Wait(mcts->pool);
+    } else {
+        while (nowNs() < mcts->deadline) {
+            iterate(mcts, &mcts->workers[0]);
+        }
+    }
+    mcts->iterations = 0;
+    for (int i = 0; i < workers; ++i) {
+        mcts->iterations += mcts->workers[i].iterations;
+    }
+    const MctsNode *root = &mcts->nodes[0];
+    mcts->value = root->visits > 0 ? (double)root->value / MCTS_VALUE_ONE / root->visits : 0;
+    uint8_t type = state->piece.type;
+    if (root->expanded[type] != MCTS_EXPANDED || root->count[type] == 0) {
+        return false;
+    }
+    const MctsNode *best = &mcts->nodes[root->first[type]];
+    for (uint32_t i = root->first[type]; i < root->first[type] + root->count[type]; ++i) {
+        const MctsNode *child = &mcts->nodes[i];
+        if (child->visits > best->visits || (child->visits == best->visits && child->value > best->value)) {
+            best = child;
+        }
+    }
+    *move = best->move;
+    return true;
+}
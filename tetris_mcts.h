@@ -0,0 +1,71 @@
+//Monte Carlo tree search player: estimates how good each placement is when the pieces past the preview are not
+//known, by playing many random continuations of the match with the headless simulation. The search is anytime
+//(it runs until its time budget is spent) and parallel, on a work-stealing pool with virtual loss
+#ifndef TETRIS_MCTS_H
+#define TETRIS_MCTS_H
+
+#include "tetris_bot.h"
+#include "tetris_steal.h"
+
+//Macro Definitions
+#define MCTS_MAX_NODES (1U << 19)      // tree size, 32 MB; once it is full the search keeps refining the nodes it has
+#define MCTS_MAX_CHILDREN 16U          // placements kept per piece type of a node, the best the evaluator scores first
+#define MCTS_MAX_DEPTH 32U             // placements a single descent makes at most
+#define MCTS_ROLLOUT_PIECES 8U         // pieces a rollout plays past the leaf
+#define MCTS_BATCH 16U                 // iterations per pool task, between deadline checks
+#define MCTS_TASKS_PER_WORKER 4U       // tasks kept in flight per worker, for the others to steal
+#define MCTS_VIRTUAL_LOSS 3U           // visits that win nothing, added along a descent until its rollout is in
+#define MCTS_EXPLORATION 0.5           // UCT exploration constant; values are in [0, 1]
+#define MCTS_VALUE_ONE 65536           // fixed point one, so value sums can be added atomically
+#define MCTS_VALUE_SCALE 3000.0        // evaluator points (hundredths) that move a rollout's value by about a quarter
+#define MCTS_LINE_VALUE 1000           // evaluator points a cleared line is worth
+
+//Expansion of a node for one piece type. MCTS_FULL: the tree had no room left for its children, so it stays a leaf
+enum {MCTS_UNEXPANDED, MCTS_EXPANDING, MCTS_EXPANDED, MCTS_FULL};
+
+//A placement and what the rollouts through it found. Children are kept per type of the piece placed next, as
+//below the preview a different piece may be dealt on every visit
+typedef struct MctsNode {
+    int64_t value;                     // rollout values summed, MCTS_VALUE_ONE each; updated atomically
+    Move move;                         // placement leading here from the parent
+    uint32_t visits;                   // rollouts through here plus virtual losses in flight; updated atomically
+    uint32_t first[PIECE_COUNT];       // first child for each piece type
+    uint8_t count[PIECE_COUNT];        // children for each piece type
+    uint8_t expanded[PIECE_COUNT];     // MCTS_UNEXPANDED, EXPANDING, EXPANDED or FULL for each piece type
+} MctsNode;
+typedef struct Mcts Mcts;
+//Scratch space of one worker, so the search never allocates
+typedef struct MctsWorker {
+    Bot rollout;                       // greedy player the rollouts use
+    EvalBatch batch;
+    int32_t scores[EVAL_BATCH];
+    Move moves[MOVES_MAX];
+    uint32_t path[MCTS_MAX_DEPTH + 1]; // nodes of the current descent, root first
+    uint64_t rng;                      // seeds the pieces of every iteration
+    uint64_t iterations;
+} MctsWorker;
+//A run of iterations one pool task makes
+typedef struct MctsTask {
+    Mcts *mcts;
+} MctsTask;
+struct Mcts {
+    StealPool *pool;                   // NULL to search on the calling thread
+    MctsNode *nodes;                   // MCTS_MAX_NODES of them inside memory, nodes[0] is the root
+    void *memory;
+    uint32_t node_count;               // updated atomically
+    MctsWorker *workers;               // one per pool worker
+    MctsTask tasks[POOL_MAX_THREADS * MCTS_TASKS_PER_WORKER];
+    TetrisState root;                  // match being searched
+    int32_t root_score;                // evaluation of the root arena, rollout values are relative to it
+    EvalWeights weights;
+    uint64_t deadline;                 // monotonic time (ns) the search stops at
+    //Results of the last search
+    uint64_t iterations;
+    double value;                      // expected value of the root position, 0 (lost) to 1
+};
+
+bool Mcts_Init(Mcts *mcts, StealPool *pool, uint64_t seed);
+void Mcts_Free(Mcts *mcts);
+bool Mcts_Search(Mcts *mcts, const TetrisState *state, uint32_t budget_ms, Move *move);
+
+#endif
@@ -0,0 +1,230 @@
+//Preprocessor Directives
+#include <string.h>
+#include "tetris_moves.h"
+
+//Macro Definitions
+#define MOVE_NODES (ROTATION_COUNT * MOVE_ROWS * MOVE_COLS)
+#define WALLS 0xFFFFF00FU   // grid columns outside the arena, and everything past the grid
+
+//Occupied columns of arena row y in grid coordinates (bit x + MOVE_PAD): walls everywhere, blocks inside the
+//arena, a solid floor below it
+static uint32_t gridRow(const uint8_t *placed, int y){
+    if (y >= (int)ARENA_HEIGHT) {
+        return 0xFFFFFFFFU;
+    }
+    return y < 0 ? WALLS : WALLS | (uint32_t)placed[y] << MOVE_PAD;
+}
+//Grows seeds to the whole runs of open they sit in: every x a piece can slide to from them along one row
+static uint16_t slideFill(uint16_t seeds, uint16_t open){
+    uint32_t left = seeds;
+    uint32_t right = seeds;
+    uint32_t open_left = open;
+    uint32_t open_right = open;
+    //Occluded fill, doubling the distance covered each step. Walls keep runs within ARENA_WIDTH
+    for (int step = 1; step < ARENA_WIDTH; step <<= 1) {
+        left |= open_left & (left << step);
+        open_left &= open_left << step;
+        right |= open_right & (right >> step);
+        open_right &= open_right >> step;
+    }
+    return (uint16_t)((left | right) & open);
+}
+//Rotation of piece whose cells are the same as rotation r, so both land the same; r itself if none is
+static uint8_t canonicalRotation(uint8_t type, uint8_t r){
+    const Shape *shape = getShape((Piece){type, r});
+    for (uint8_t c = 0; c < r; ++c) {
+        const Shape *other = getShape((Piece){type, c});
+        if (other->w != shape->w || other->h != shape->h) {
+            continue;
+        }
+        bool same = true;
+        for (int y = 0; y < shape->h && same; ++y) {
+            same = shape->rows[shape->start_y + y] >> shape->start_x == other->rows[other->start_y + y] >> other->start_x;
+        }
+        if (same) {
+            return c;
+        }
+    }
+    return r;
+}
+//Bit x set for every x at which rotation r of piece type fits with the top of its box on grid row y
+static uint16_t fitRow(const uint32_t *grid, uint8_t type, uint8_t r, int y){
+    const Shape *shape = getShape((Piece){type, r});
+    uint32_t blocked = 0;
+    for (int row = shape->start_y; row < shape->start_y + shape->h; ++row) {
+        for (uint32_t cells = shape->rows[row]; cells; cells &= cells - 1) {
+            blocked |= grid[y + row] >> __builtin_ctz(cells);
+        }
+    }
+    return (uint16_t)~blocked;
+}
+//Fills moves (room for MOVES_MAX) with every distinct placement piece can lock in, starting from position and
+//using any mix of shifts, wall-nudged rotations and one-row drops, ignoring gravity, so slides and tucks under
+//overhangs are included. Placements with the same cells are listed once, whichever rotation reached them.
+//Works a row at a time on bitmasks of the x positions that fit, and stops at the first row nothing reaches, so
+//one call costs about as much as a few dozen collisionChecks. Returns the number of placements, 0 if the piece
+//does not fit where it starts
+int Moves_Generate(const uint8_t *placed, Piece piece, Position position, Move *moves){
+    if (position.y < -(int)MOVE_PAD || position.y >= (int)ARENA_HEIGHT || position.x < -(int)MOVE_PAD ||
+        position.x >= (int)(ARENA_WIDTH + MOVE_PAD)) {
+        return 0;
+    }
+    //Nothing ever moves up, so rows above the start can be skipped
+    int top = position.y + MOVE_PAD;
+    uint32_t grid[MOVE_ROWS + PIECE_HEIGHT];
+    int surface = MOVE_ROWS + PIECE_HEIGHT;   // first grid row with a block or the floor in it
+    for (int y = (int)(MOVE_ROWS + PIECE_HEIGHT) - 1; y >= top; --y) {
+        grid[y] = gridRow(placed, y - (int)MOVE_PAD);
+        surface = grid[y] != WALLS ? y : surface;
+    }
+    uint16_t in_walls[ROTATION_COUNT];
+    uint16_t fit[ROTATION_COUNT];
+    uint16_t fit_below[ROTATION_COUNT];
+    uint16_t reach[ROTATION_COUNT] = {0};
+    int dx[ROTATION_COUNT];
+    int dy[ROTATION_COUNT];
+    uint8_t canonical[ROTATION_COUNT];
+    for (uint8_t r = 0; r < ROTATION_COUNT; ++r) {
+        const Shape *shape = getShape((Piece){piece.type, r});
+        in_walls[r] = (uint16_t)(((1U << (ARENA_WIDTH - shape->w + 1)) - 1) << (MOVE_PAD - shape->start_x));
+        fit_below[r] = fitRow(grid, piece.type, r, top);
+        canonical[r] = canonicalRotation(piece.type, r);
+        dx[r] = shape->start_x - getShape((Piece){piece.type, canonical[r]})->start_x;
+        dy[r] = shape->start_y - getShape((Piece){piece.type, canonical[r]})->start_y;
+    }
+    reach[piece.rotation] = (uint16_t)(1U << (position.x + MOVE_PAD)) & fit_below[piece.rotation];
+    //seen[c][y]: placements already listed, in the coordinates of canonical rotation c
+    uint16_t seen[ROTATION_COUNT][MOVE_ROWS] = {{0}};
+    int count = 0;
+    //Rotations keep the row and drops only go down, so everything reachable on a row is known before the next
+    for (int y = top; y < (int)MOVE_ROWS; ++y) {
+        uint8_t pending = 0;   // rotations that gained positions not slid and turned yet
+        bool closed = true;    // every position that fits was reached from above, so sliding and turning add none
+        for (uint8_t r = 0; r < ROTATION_COUNT; ++r) {
+            fit[r] = fit_below[r];
+            //A box wholly above the surface fits anywhere between the walls
+            if (y + 1 + (int)PIECE_HEIGHT <= surface) {
+                fit_below[r] = in_walls[r];
+            } else {
+                fit_below[r] = y + 1 < (int)MOVE_ROWS ? fitRow(grid, piece.type, r, y + 1) : 0;
+            }
+            reach[r] &= fit[r];
+            pending |= (reach[r] != 0) << r;
+            closed = closed && reach[r] == fit[r];
+        }
+        if (!pending) {
+            break;
+        }
+        if (closed) {
+            pending = 0;
+        }
+        uint16_t turned[ROTATION_COUNT] = {0};
+        for (uint8_t r = 0; pending; r = (r + 1) % ROTATION_COUNT) {
+            if (!(pending & 1U << r)) {
+                continue;
+            }
+            pending &= ~(1U << r);
+            reach[r] = slideFill(reach[r], fit[r]);
+            //Only the few positions that poke through a wall once turned need the nudge worked out one at a time
+            uint8_t next = (r + 1) % ROTATION_COUNT;
+            uint16_t fresh = reach[r] & ~turned[r];
+            turned[r] |= fresh;
+            uint16_t landed = fresh & in_walls[next] & fit[next];
+            for (uint16_t nudged = fresh & ~in_walls[next]; nudged; nudged &= nudged - 1) {
+                Piece turning = {piece.type, r};
+                Position at = {(int8_t)(__builtin_ctz(nudged) - MOVE_PAD), (int8_t)(y - MOVE_PAD)};
+                if (rotateNudged(placed, &turning, &at)) {
+                    landed |= (uint16_t)(1U << (at.x + MOVE_PAD));
+                }
+            }
+            if (landed & ~reach[next]) {
+                reach[next] |= landed;
+                pending |= 1U << next;
+            }
+        }
+        //A reachable position locks when it cannot drop further
+        for (uint8_t r = 0; r < ROTATION_COUNT; ++r) {
+            uint16_t locks = reach[r] & ~fit_below[r];
+            if (!locks) {
+                continue;
+            }
+            //Same cells, so the canonical rotation's bits are these shifted by the box offset
+            uint16_t *same = &seen[canonical[r]][y + dy[r]];
+            uint16_t shifted = (uint16_t)(dx[r] >= 0 ? locks << dx[r] : locks >> -dx[r]);
+            locks &= (uint16_t)(dx[r] >= 0 ? ~*same >> dx[r] : ~*same << -dx[r]);
+            *same |= shifted;
+            for (; locks; locks &= locks - 1) {
+                Move move = {{piece.type, r}, {(int8_t)(__builtin_ctz(locks) - MOVE_PAD), (int8_t)(y - MOVE_PAD)}};
+                moves[count++] = move;
+            }
+        }
+        //Rows wholly above the surface all play out like a closed one, so skip to where the blocks start
+        if (closed && y + (int)PIECE_HEIGHT + 1 < surface) {
+            y = surface - (int)PIECE_HEIGHT - 1;
+        }
+    }
+    return count;
+}
+//Shortest list of TETRIS_INPUT_LEFT, RIGHT, ROTATE and SOFT_DROP (each a single step: one column, one turn, one
+//row) taking piece from position to target, as found by Moves_Generate. Writes at most max inputs and returns
+//how many, or -1 if target cannot be reached or the path is longer than max
+int Moves_Path(const uint8_t *placed, Piece piece, Position position, Move target, uint8_t *inputs, int max){
+    const uint8_t actions[4] = {TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE, TETRIS_INPUT_SOFT_DROP};
+    int16_t parent[MOVE_NODES];
+    uint8_t action[MOVE_NODES];
+    uint16_t queue[MOVE_NODES];
+    if (position.y < -(int)MOVE_PAD || position.x < -(int)MOVE_PAD || position.x >= (int)(ARENA_WIDTH + MOVE_PAD) ||
+        collisionCheck(placed, piece, position) != COLLIDE_NONE) {
+        return -1;
+    }
+    int goal = (target.piece.rotation * MOVE_ROWS + target.position.y + MOVE_PAD) * MOVE_COLS + target.position.x + MOVE_PAD;
+    if (target.position.x < -(int)MOVE_PAD || target.position.x >= (int)(ARENA_WIDTH + MOVE_PAD) || goal < 0 ||
+        goal >= (int)MOVE_NODES) {
+        return -1;
+    }
+    memset(parent, -1, sizeof(parent));
+    int first = (piece.rotation * MOVE_ROWS + position.y + MOVE_PAD) * MOVE_COLS + position.x + MOVE_PAD;
+    int head = 0;
+    int tail = 0;
+    queue[tail++] = (uint16_t)first;
+    parent[first] = (int16_t)first;
+    while (head < tail && parent[goal] < 0) {
+        int node = queue[head++];
+        for (int a = 0; a < 4; ++a) {
+            Piece moved = {piece.type, (uint8_t)(node / (MOVE_ROWS * MOVE_COLS))};
+            Position at = {(int8_t)(node % MOVE_COLS - MOVE_PAD), (int8_t)(node / MOVE_COLS % MOVE_ROWS - MOVE_PAD)};
+            if (actions[a] == TETRIS_INPUT_ROTATE) {
+                if (!rotateNudged(placed, &moved, &at)) {
+                    continue;
+                }
+            } else {
+                at.x += actions[a] == TETRIS_INPUT_LEFT ? -1 : (actions[a] == TETRIS_INPUT_RIGHT ? 1 : 0);
+                at.y += actions[a] == TETRIS_INPUT_SOFT_DROP;
+                if (collisionCheck(placed, moved, at) != COLLIDE_NONE) {
+                    continue;
+                }
+            }
+            int reached = (moved.rotation * MOVE_ROWS + at.y + MOVE_PAD) * MOVE_COLS + at.x + MOVE_PAD;
+            if (parent[reached] < 0) {
+                parent[reached] = (int16_t)node;
+                action[reached] = actions[a];
+                queue[tail++] = (uint16_t)reached;
+            }
+        }
+    }
+    if (parent[goal] < 0) {
+        return -1;
+    }
+    int length = 0;
+    for (int node = goal; node != first; node = parent[node]) {
+        length++;
+    }
+    if (length > max) {
+        return -1;
+    }
+    int i = length;
+    for (int node = goal; node != first; node = parent[node]) {
+        inputs[--i] = action[node];
+    }
+    return length;
+}
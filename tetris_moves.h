@@ -0,0 +1,24 @@
+//Move generation: every placement a falling piece can reach and lock in, for bots and analysis
+#ifndef TETRIS_MOVES_H
+#define TETRIS_MOVES_H
+
+#include "tetris_core.h"
+
+//Macro Definitions
+#define MOVE_PAD 4U                                      // columns/rows of the search grid beyond the arena walls and above its top
+#define MOVE_COLS (ARENA_WIDTH + 2 * MOVE_PAD)           // one bit per x in [-MOVE_PAD, ARENA_WIDTH + MOVE_PAD) of a uint16_t
+#define MOVE_ROWS (ARENA_HEIGHT + MOVE_PAD)              // y in [-MOVE_PAD, ARENA_HEIGHT)
+#define MOVES_MAX (ROTATION_COUNT * ARENA_WIDTH * (MOVE_ROWS / 2))  // placements one call can return: a column of one
+                                                         // rotation lands at most every other row
+static_assert(MOVE_COLS <= 16, "a row of the search grid must fit in a uint16_t");
+
+//A placement: the piece and where it locks
+typedef struct Move {
+    Piece piece;
+    Position position;
+} Move;
+
+int Moves_Generate(const uint8_t *placed, Piece piece, Position position, Move *moves);
+int Moves_Path(const uint8_t *placed, Piece piece, Position position, Move target, uint8_t *inputs, int max);
+
+#endif
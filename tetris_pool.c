@@ -0,0 +1,101 @@
+//Preprocessor Directives
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "tetris_pool.h"
+
+//Number of processors, the usual number of workers
+int ThreadPool_DefaultThreads(void){
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count < 1 ? 1 : (count > POOL_MAX_THREADS ? POOL_MAX_THREADS : count);
+}
+//Runs jobs until the pool stops and its queue is empty
+static void *workerMain(void *arg){
+    PoolWorker *worker = (PoolWorker *)arg;
+    ThreadPool *pool = worker->pool;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->head == pool->tail && !pool->stopping) {
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        }
+        if (pool->head == pool->tail) {
+            break;
+        }
+        PoolJob job = pool->jobs[pool->head++ % POOL_QUEUE_SIZE];
+        pthread_cond_signal(&pool->space);
+        pthread_mutex_unlock(&pool->lock);
+        job.task(job.arg, worker->index);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->outstanding == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+//Starts threads workers (at most POOL_MAX_THREADS). Fails if not even one could be started
+bool ThreadPool_Start(ThreadPool *pool, int threads){
+    memset(pool, 0, sizeof(ThreadPool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready, NULL);
+    pthread_cond_init(&pool->space, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    threads = threads < 1 ? 1 : (threads > POOL_MAX_THREADS ? POOL_MAX_THREADS : threads);
+    for (int i = 0; i < threads; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, workerMain, &pool->workers[i]) != 0) {
+            break;
+        }
+        pool->count++;
+    }
+    if (pool->count == 0) {
+        ThreadPool_Stop(pool);
+        return false;
+    }
+    return true;
+}
+//Queues task(arg), waiting for room if POOL_QUEUE_SIZE tasks are already queued
+void ThreadPool_Submit(ThreadPool *pool, PoolTask task, void *arg){
+    pthread_mutex_lock(&pool->lock);
+    while (pool->tail - pool->head == POOL_QUEUE_SIZE) {
+        pthread_cond_wait(&pool->space, &pool->lock);
+    }
+    PoolJob job = {.task = task, .arg = arg};
+    pool->jobs[pool->tail++ % POOL_QUEUE_SIZE] = job;
+    pool->outstanding++;
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+//Blocks until every submitted task has finished
+void ThreadPool_Wait(ThreadPool *pool){
+    pthread_mutex_lock(&pool->lock);
+    while (pool->outstanding > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+//Finishes the queued tasks, then joins the workers
+void ThreadPool_Stop(ThreadPool *pool){
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pool->count = 0;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->ready);
+    pthread_cond_destroy(&pool->space);
+    pthread_cond_destroy(&pool->idle);
+}
@@ -0,0 +1,47 @@
+//Fixed set of worker threads running tasks from a bounded queue
+#ifndef TETRIS_POOL_H
+#define TETRIS_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//Macro Definitions
+#define POOL_MAX_THREADS 64
+#define POOL_QUEUE_SIZE 256U   // tasks waiting for a worker; ThreadPool_Submit blocks while the queue is full
+
+//A task gets its argument and the index of the worker running it, for per-worker scratch space
+typedef void (*PoolTask)(void *arg, int worker);
+typedef struct PoolJob {
+    PoolTask task;
+    void *arg;
+} PoolJob;
+typedef struct ThreadPool ThreadPool;
+//One worker thread and the index its tasks are told
+typedef struct PoolWorker {
+    pthread_t thread;
+    ThreadPool *pool;
+    int index;
+} PoolWorker;
+struct ThreadPool {
+    PoolWorker workers[POOL_MAX_THREADS];
+    int count;                        // worker threads running
+    pthread_mutex_t lock;             // guards everything below
+    pthread_cond_t ready;             // signalled when a job is queued or the pool stops
+    pthread_cond_t space;             // signalled when a job leaves the queue
+    pthread_cond_t idle;              // signalled when the last outstanding job finishes
+    PoolJob jobs[POOL_QUEUE_SIZE];
+    uint32_t head;                    // next job to run
+    uint32_t tail;                    // where the next job is queued
+    uint32_t outstanding;             // jobs queued or running
+    bool stopping;
+};
+
+int ThreadPool_DefaultThreads(void);
+bool ThreadPool_Start(ThreadPool *pool, int threads);
+void ThreadPool_Submit(ThreadPool *pool, PoolTask task, void *arg);
+void ThreadPool_Wait(ThreadPool *pool);
+void ThreadPool_Stop(ThreadPool *pool);
+
+#endif
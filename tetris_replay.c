@@ -0,0 +1,379 @@
+//Preprocessor Directives
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tetris_replay.h"
+
+//Makes room for extra bytes at the end of the replay
+static bool reserve(Replay *replay, size_t extra){
+    if (replay->size + extra <= replay->capacity) {
+        return true;
+    }
+    size_t capacity = MAX(replay->capacity * 2, replay->size + extra);
+    capacity = MAX(capacity, 256);
+    uint8_t *data = (uint8_t *)realloc(replay->data, capacity);
+    if (data == NULL) {
+        return false;
+    }
+    replay->data = data;
+    replay->capacity = capacity;
+    return true;
+}
+//Appends value as a LEB128 varint: 7 bits per byte, low bits first, high bit set on all but the last byte
+static bool putVarint(Replay *replay, uint64_t value){
+    if (!reserve(replay, 10)) {
+        return false;
+    }
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        replay->data[replay->size++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return true;
+}
+//Reads a varint at *pos, failing if it runs past size or does not fit in 64 bits
+static bool getVarint(const uint8_t *data, size_t size, size_t *pos, uint64_t *value){
+    *value = 0;
+    for (unsigned shift = 0; shift < 64 && *pos < size; shift += 7) {
+        uint8_t byte = data[(*pos)++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+//Appends a 32-bit little-endian value
+static bool putU32(Replay *replay, uint32_t value){
+    if (!reserve(replay, 4)) {
+        return false;
+    }
+    for (int i = 0; i < 4; ++i) {
+        replay->data[replay->size++] = (uint8_t)(value >> (8 * i));
+    }
+    return true;
+}
+//Reads a 32-bit little-endian value
+static uint32_t getU32(const uint8_t *data){
+    return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+//Decodes the record at *pos, moving *tick on by its delta. A keyframe record is left with *pos on its snapshot.
+//Fails on records that run past size or name no known action
+static bool parseRecord(const uint8_t *data, size_t size, size_t *pos, uint32_t *tick, uint8_t *action, bool *pressed,
+                        uint8_t *offset){
+    uint64_t record;
+    if (!getVarint(data, size, pos, &record) || (record >> 4) > UINT32_MAX - *tick) {
+        return false;
+    }
+    *tick += (uint32_t)(record >> 4);
+    *pressed = (record >> 3) & 1;
+    *action = record & 0x7;
+    switch (*action) {
+        case REPLAY_ACTION_END:
+            return true;
+        case REPLAY_ACTION_KEYFRAME:
+            return *pos + TETRIS_SNAPSHOT_SIZE <= size;
+        default:
+            if (*pos >= size || (1U << *action) > TETRIS_INPUT_HARD_DROP) {
+                return false;
+            }
+            *offset = data[(*pos)++];
+            return true;
+    }
+}
+//Starts recording a match. state must have just been set up: Tetris_Init with seed, plus its das and arr
+bool Replay_Begin(Replay *replay, const TetrisState *state, uint64_t seed){
+    replay->size = 0;
+    replay->last_tick = state->ticks;
+    replay->ended = false;
+    if (!reserve(replay, REPLAY_HEADER_SIZE)) {
+        return false;
+    }
+    uint8_t *header = replay->data;
+    memcpy(header, REPLAY_MAGIC, 4);
+    header[4] = REPLAY_VERSION;
+    header[5] = TETRIS_RULES_VERSION;
+    header[6] = state->randomizer;
+    header[7] = state->das;
+    header[8] = state->arr;
+    header[9] = REPLAY_KEYFRAME_PIECES;
+    for (int i = 0; i < 8; ++i) {
+        header[10 + i] = (uint8_t)(seed >> (8 * i));
+    }
+    replay->size = REPLAY_HEADER_SIZE;
+    replay->next_keyframe = REPLAY_KEYFRAME_PIECES;
+    return true;
+}
+//Records a key event just before it is passed to Tetris_Input with the same arguments.
+//input holds one TETRIS_INPUT_* bit; events for unmapped keys (TETRIS_INPUT_NONE) change nothing and are skipped
+bool Replay_Input(Replay *replay, const TetrisState *state, uint8_t input, bool pressed, uint32_t time){
+    if (input == TETRIS_INPUT_NONE || replay->ended) {
+        return true;
+    }
+    //Tetris_Input clamps the time into the current tick, so anything past a byte's worth is the same
+    uint32_t now = Tetris_Time(state);
+    uint8_t offset = time > now ? (uint8_t)MIN(time - now, UINT8_MAX) : 0;
+    uint64_t record = (uint64_t)(state->ticks - replay->last_tick) << 4 | (uint64_t)pressed << 3 | __builtin_ctz(input);
+    replay->last_tick = state->ticks;
+    if (!putVarint(replay, record) || !reserve(replay, 1)) {
+        return false;
+    }
+    replay->data[replay->size++] = offset;
+    return true;
+}
+//Called after every Tetris_Step: once another REPLAY_KEYFRAME_PIECES pieces have spawned, snapshots the state so
+//playback can seek here instead of simulating from the start
+bool Replay_Step(Replay *replay, const TetrisState *state){
+    if (replay->ended || state->pieces < replay->next_keyframe) {
+        return true;
+    }
+    uint64_t record = (uint64_t)(state->ticks - replay->last_tick) << 4 | REPLAY_ACTION_KEYFRAME;
+    if (!putVarint(replay, record) || !reserve(replay, TETRIS_SNAPSHOT_SIZE)) {
+        return false;
+    }
+    Tetris_Save(state, replay->data + replay->size);
+    replay->size += TETRIS_SNAPSHOT_SIZE;
+    replay->last_tick = state->ticks;
+    replay->next_keyframe = (state->pieces / REPLAY_KEYFRAME_PIECES + 1) * REPLAY_KEYFRAME_PIECES;
+    return true;
+}
+//Closes the event stream at the state's current tick and appends the keyframe index
+bool Replay_End(Replay *replay, const TetrisState *state){
+    if (replay->ended) {
+        return true;
+    }
+    if (!putVarint(replay, (uint64_t)(state->ticks - replay->last_tick) << 4 | REPLAY_ACTION_END)) {
+        return false;
+    }
+    //One pass over the stream finds the keyframes again, which saves keeping a second list while recording
+    size_t end = replay->size;
+    size_t pos = REPLAY_HEADER_SIZE;
+    uint32_t tick = 0;
+    uint32_t count = 0;
+    uint8_t action = 0;
+    while (action != REPLAY_ACTION_END) {
+        uint8_t offset;
+        bool pressed;
+        if (!parseRecord(replay->data, end, &pos, &tick, &action, &pressed, &offset)) {
+            return false;
+        }
+        if (action == REPLAY_ACTION_KEYFRAME) {
+            if (!putU32(replay, tick) || !putU32(replay, (uint32_t)pos)) {
+                return false;
+            }
+            pos += TETRIS_SNAPSHOT_SIZE;
+            count++;
+        }
+    }
+    if (!putU32(replay, count) || !reserve(replay, 4)) {
+        return false;
+    }
+    memcpy(replay->data + replay->size, REPLAY_INDEX_MAGIC, 4);
+    replay->size += 4;
+    replay->ended = true;
+    return true;
+}
+//Writes the replay to path
+bool Replay_Save(const Replay *replay, const char *path){
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool ok = fwrite(replay->data, 1, replay->size, file) == replay->size;
+    return fclose(file) == 0 && ok;
+}
+//Reads a whole replay file into replay
+bool Replay_Load(Replay *replay, const char *path){
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    replay->size = 0;
+    replay->ended = true;
+    uint8_t chunk[4096];
+    size_t read;
+    bool ok = true;
+    while (ok && (read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        ok = reserve(replay, read);
+        if (ok) {
+            memcpy(replay->data + replay->size, chunk, read);
+            replay->size += read;
+        }
+    }
+    ok = ok && !ferror(file);
+    fclose(file);
+    return ok;
+}
+//Releases the replay's buffer
+void Replay_Free(Replay *replay){
+    free(replay->data);
+    memset(replay, 0, sizeof(Replay));
+}
+//Reads the next input or end record, stepping over keyframes, or marks the stream as ended if it is malformed
+static void readRecord(ReplayPlayer *player){
+    do {
+        if (!parseRecord(player->data, player->size, &player->pos, &player->next_tick, &player->next_action,
+                         &player->next_pressed, &player->next_offset)) {
+            player->next_action = REPLAY_ACTION_END;
+            player->corrupt = true;
+            return;
+        }
+        if (player->next_action == REPLAY_ACTION_KEYFRAME) {
+            player->pos += TETRIS_SNAPSHOT_SIZE;
+        }
+    } while (player->next_action == REPLAY_ACTION_KEYFRAME);
+}
+//Finds the keyframe index behind the stream. A replay without a usable one still plays, it just cannot seek
+static void findKeyframes(ReplayPlayer *player){
+    const uint8_t *data = player->data;
+    size_t size = player->size;
+    if (size < REPLAY_HEADER_SIZE + 8 || memcmp(data + size - 4, REPLAY_INDEX_MAGIC, 4) != 0) {
+        return;
+    }
+    uint32_t count = getU32(data + size - 8);
+    if (count > (size - REPLAY_HEADER_SIZE - 8) / REPLAY_INDEX_ENTRY_SIZE) {
+        return;
+    }
+    const uint8_t *index = data + size - 8 - (size_t)count * REPLAY_INDEX_ENTRY_SIZE;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t offset = getU32(index + i * REPLAY_INDEX_ENTRY_SIZE + 4);
+        if (offset < REPLAY_HEADER_SIZE || offset + TETRIS_SNAPSHOT_SIZE > (size_t)(index - data)) {
+            return;
+        }
+    }
+    player->keyframes = index;
+    player->keyframe_count = count;
+}
+//Checks the replay header and starts state as the recorded match. data must outlive the player
+bool ReplayPlayer_Open(ReplayPlayer *player, const uint8_t *data, size_t size, TetrisState *state){
+    memset(player, 0, sizeof(ReplayPlayer));
+    if (size < REPLAY_HEADER_SIZE || memcmp(data, REPLAY_MAGIC, 4) != 0 || data[4] != REPLAY_VERSION) {
+        return false;
+    }
+    player->data = data;
+    player->size = size;
+    player->rules = data[5];
+    player->keyframe_pieces = data[9];
+    for (int i = 0; i < 8; ++i) {
+        player->seed |= (uint64_t)data[10 + i] << (8 * i);
+    }
+    //A replay only plays back the same under the rules it was recorded with
+    if (player->rules != TETRIS_RULES_VERSION || data[6] >= TETRIS_RANDOMIZER_COUNT) {
+        return false;
+    }
+    Tetris_Init(state, player->seed, data[6]);
+    state->das = data[7];
+    state->arr = data[8];
+    player->pos = REPLAY_HEADER_SIZE;
+    readRecord(player);
+    findKeyframes(player);
+    return true;
+}
+//Whether playback has reached the end of the recording (or the match is over)
+bool ReplayPlayer_Done(const ReplayPlayer *player, const TetrisState *state){
+    return state->game_over || (player->next_action == REPLAY_ACTION_END && state->ticks >= player->next_tick);
+}
+//Plays the next thing in the recording: the next event if one is due in the current tick, otherwise the tick
+//itself. A single call locks at most one piece. Returns the TETRIS_EVENT_* that happened
+uint16_t ReplayPlayer_Advance(ReplayPlayer *player, TetrisState *state){
+    if (ReplayPlayer_Done(player, state)) {
+        return TETRIS_EVENT_NONE;
+    }
+    if (player->next_action != REPLAY_ACTION_END && player->next_tick == state->ticks) {
+        uint32_t time = Tetris_Time(state) + player->next_offset;
+        uint16_t events = Tetris_Input(state, 1U << player->next_action, player->next_pressed, time);
+        readRecord(player);
+        return events;
+    }
+    return Tetris_Step(state, TETRIS_INPUT_NONE);
+}
+//Feeds the events recorded for the current tick, then advances the match by one tick the way the game loop does.
+//Returns the TETRIS_EVENT_* that happened
+uint16_t ReplayPlayer_Step(ReplayPlayer *player, TetrisState *state){
+    uint16_t events = TETRIS_EVENT_NONE;
+    uint32_t tick = state->ticks;
+    while (state->ticks == tick && !ReplayPlayer_Done(player, state)) {
+        events |= ReplayPlayer_Advance(player, state);
+    }
+    return events;
+}
+//Restarts playback from keyframe k, or from the start of the match when k is -1
+static bool loadKeyframe(ReplayPlayer *player, TetrisState *state, int64_t k){
+    if (k < 0) {
+        return ReplayPlayer_Open(player, player->data, player->size, state);
+    }
+    const uint8_t *entry = player->keyframes + k * REPLAY_INDEX_ENTRY_SIZE;
+    uint32_t offset = getU32(entry + 4);
+    if (!Tetris_Load(state, player->data + offset)) {
+        return false;
+    }
+    player->next_tick = getU32(entry);
+    player->pos = offset + TETRIS_SNAPSHOT_SIZE;
+    player->corrupt = false;
+    readRecord(player);
+    return true;
+}
+//Number of pieces spawned by the time of keyframe k
+static uint32_t keyframePieces(const ReplayPlayer *player, uint32_t k){
+    //pieces is the fifth field of a snapshot, after score, rng and total_rows_cleared
+    return getU32(player->data + getU32(player->keyframes + k * REPLAY_INDEX_ENTRY_SIZE + 4) + 20);
+}
+//Moves playback to the tick piece number `piece` spawned on. Keyframe k holds at least (k + 1) * keyframe_pieces
+//pieces, so the right one is found directly from the piece number, then at most keyframe_pieces are simulated
+bool ReplayPlayer_SeekPiece(ReplayPlayer *player, TetrisState *state, uint32_t piece){
+    int64_t k = -1;
+    if (player->keyframe_pieces > 0) {
+        k = (int64_t)MIN(piece / player->keyframe_pieces, player->keyframe_count) - 1;
+    }
+    //Several pieces can lock in one tick, so a keyframe may land a few pieces past its multiple
+    while (k >= 0 && keyframePieces(player, (uint32_t)k) > piece) {
+        k--;
+    }
+    if (!loadKeyframe(player, state, k)) {
+        return false;
+    }
+    while (state->pieces < piece && !ReplayPlayer_Done(player, state)) {
+        ReplayPlayer_Step(player, state);
+    }
+    return state->pieces >= piece;
+}
+//Moves playback to the start of tick `tick`, from the last keyframe at or before it
+bool ReplayPlayer_SeekTick(ReplayPlayer *player, TetrisState *state, uint32_t tick){
+    int64_t low = 0;
+    int64_t high = (int64_t)player->keyframe_count - 1;
+    int64_t k = -1;
+    while (low <= high) {
+        int64_t mid = (low + high) / 2;
+        if (getU32(player->keyframes + mid * REPLAY_INDEX_ENTRY_SIZE) <= tick) {
+            k = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    if (!loadKeyframe(player, state, k)) {
+        return false;
+    }
+    while (state->ticks < tick && !ReplayPlayer_Done(player, state)) {
+        ReplayPlayer_Step(player, state);
+    }
+    return state->ticks == tick;
+}
+//Re-simulates a replay from its seed and checks that it is a complete, well-formed match that ended in a game over
+//with exactly the claimed score. state is left holding the final position
+uint8_t Replay_Verify(const uint8_t *data, size_t size, uint64_t claimed, TetrisState *state){
+    ReplayPlayer player;
+    if (!ReplayPlayer_Open(&player, data, size, state)) {
+        return REPLAY_UNREADABLE;
+    }
+    while (!ReplayPlayer_Done(&player, state)) {
+        ReplayPlayer_Step(&player, state);
+    }
+    if (player.corrupt) {
+        return REPLAY_CORRUPT;
+    }
+    if (!state->game_over) {
+        return REPLAY_UNFINISHED;
+    }
+    return state->score == claimed ? REPLAY_VERIFIED : REPLAY_SCORE_MISMATCH;
+}
@@ -0,0 +1,68 @@
+//Recording and playback of matches as compact binary replays
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include <stddef.h>
+#include "tetris_core.h"
+
+//Macro Definitions
+#define REPLAY_MAGIC "TRPL"
+#define REPLAY_VERSION 3U
+#define REPLAY_HEADER_SIZE 18U       // magic, format version, rules version, randomizer, das, arr, keyframe interval, seed
+#define REPLAY_ACTION_KEYFRAME 6U    // action code of a record carrying a state snapshot
+#define REPLAY_ACTION_END 7U         // action code closing the event stream
+#define REPLAY_KEYFRAME_PIECES 16U   // pieces between keyframes
+#define REPLAY_INDEX_MAGIC "TKFI"
+#define REPLAY_INDEX_ENTRY_SIZE 8U   // tick and file offset of one keyframe
+
+//Outcome of Replay_Verify
+enum {REPLAY_VERIFIED, REPLAY_UNREADABLE, REPLAY_CORRUPT, REPLAY_UNFINISHED, REPLAY_SCORE_MISMATCH};
+
+//A replay file is REPLAY_HEADER_SIZE header bytes followed by one record per key event:
+//a varint of (ticks since the previous record << 4 | pressed << 3 | action), where action is the bit index of the
+//TETRIS_INPUT_* that changed, then one byte holding the event time in ms past the start of its tick.
+//Every REPLAY_KEYFRAME_PIECES pieces a REPLAY_ACTION_KEYFRAME record is followed by a TETRIS_SNAPSHOT_SIZE snapshot
+//of the state at the start of its tick. A record with action REPLAY_ACTION_END (and nothing after it) marks the
+//tick the recording stopped at. Behind the stream sits the keyframe index: the tick and snapshot offset of every
+//keyframe, then their count and REPLAY_INDEX_MAGIC. All multi-byte fields are little endian
+typedef struct Replay {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint32_t last_tick;      // tick of the most recent record
+    uint32_t next_keyframe;  // piece count that triggers the next keyframe
+    bool ended;              // the end record has been written
+} Replay;
+//Reads a replay back one tick at a time, feeding its events into a TetrisState
+typedef struct ReplayPlayer {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;                  // offset of the next record
+    uint64_t seed;
+    const uint8_t *keyframes;    // the keyframe index inside data
+    uint32_t keyframe_count;     // entries in the index, 0 if the replay has none or it is damaged
+    uint32_t next_tick;          // tick of the record at pos
+    uint8_t rules;               // TETRIS_RULES_VERSION the replay was recorded with
+    uint8_t keyframe_pieces;     // pieces between keyframes
+    uint8_t next_action;         // action of the record at pos, REPLAY_ACTION_END once the stream is exhausted
+    uint8_t next_offset;         // time of the record at pos, in ms past the start of its tick
+    bool next_pressed;
+    bool corrupt;                // the stream held a malformed record or stopped without an end record
+} ReplayPlayer;
+
+bool Replay_Begin(Replay *replay, const TetrisState *state, uint64_t seed);
+bool Replay_Input(Replay *replay, const TetrisState *state, uint8_t input, bool pressed, uint32_t time);
+bool Replay_Step(Replay *replay, const TetrisState *state);
+bool Replay_End(Replay *replay, const TetrisState *state);
+bool Replay_Save(const Replay *replay, const char *path);
+bool Replay_Load(Replay *replay, const char *path);
+void Replay_Free(Replay *replay);
+bool ReplayPlayer_Open(ReplayPlayer *player, const uint8_t *data, size_t size, TetrisState *state);
+bool ReplayPlayer_Done(const ReplayPlayer *player, const TetrisState *state);
+uint16_t ReplayPlayer_Advance(ReplayPlayer *player, TetrisState *state);
+uint16_t ReplayPlayer_Step(ReplayPlayer *player, TetrisState *state);
+bool ReplayPlayer_SeekPiece(ReplayPlayer *player, TetrisState *state, uint32_t piece);
+bool ReplayPlayer_SeekTick(ReplayPlayer *player, TetrisState *state, uint32_t tick);
+uint8_t Replay_Verify(const uint8_t *data, size_t size, uint64_t claimed, TetrisState *state);
+
+#endif
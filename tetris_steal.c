@@ -0,0 +1,231 @@
+//Preprocessor Directives
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "tetris_steal.h"
+#include "tetris_core.h"
+
+//Worker the calling thread is, so tasks submitted from inside a task go to that worker's own deque
+static __thread StealWorker *current_worker;
+
+//Owner side: adds job at the bottom. Fails if the deque is full
+static bool dequePush(StealDeque *deque, PoolJob job){
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= (int64_t)STEAL_DEQUE_SIZE) {
+        return false;
+    }
+    PoolJob *slot = &deque->jobs[bottom & (STEAL_DEQUE_SIZE - 1)];
+    __atomic_store_n(&slot->task, job.task, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->arg, job.arg, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return true;
+}
+//Owner side: takes the newest job. Races thieves only for the last one
+static bool dequeTake(StealDeque *deque, PoolJob *job){
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    PoolJob *slot = &deque->jobs[bottom & (STEAL_DEQUE_SIZE - 1)];
+    job->task = __atomic_load_n(&slot->task, __ATOMIC_RELAXED);
+    job->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+    if (top == bottom) {
+        bool won = __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+//Thief side: takes the oldest job. Fails if the deque is empty or another thread got there first
+static bool dequeSteal(StealDeque *deque, PoolJob *job){
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) {
+        return false;
+    }
+    //The owner never reuses this slot while top still points at it, so a successful exchange means it was intact
+    PoolJob *slot = &deque->jobs[top & (STEAL_DEQUE_SIZE - 1)];
+    job->task = __atomic_load_n(&slot->task, __ATOMIC_RELAXED);
+    job->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+//Counts a newly queued task and wakes a worker if any are asleep
+static void announce(StealPool *pool){
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->ready);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+//Takes the oldest task submitted from outside the pool
+static bool takeInbox(StealPool *pool, PoolJob *job){
+    if (__atomic_load_n(&pool->head, __ATOMIC_RELAXED) == __atomic_load_n(&pool->tail, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    pthread_mutex_lock(&pool->lock);
+    bool found = pool->head != pool->tail;
+    if (found) {
+        *job = pool->inbox[pool->head % POOL_QUEUE_SIZE];
+        __atomic_store_n(&pool->head, pool->head + 1, __ATOMIC_RELAXED);
+        pthread_cond_signal(&pool->space);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return found;
+}
+//Next task for worker: its own newest, then the inbox, then the oldest of another worker's, trying the others
+//from a random one on
+static bool findTask(StealWorker *worker, PoolJob *job){
+    StealPool *pool = worker->pool;
+    if (dequeTake(&worker->deque, job) || takeInbox(pool, job)) {
+        return true;
+    }
+    int count = __atomic_load_n(&pool->count, __ATOMIC_ACQUIRE);
+    int first = (int)(Tetris_Random(&worker->rng) % (uint32_t)count);
+    for (int i = 0; i < count; ++i) {
+        StealWorker *victim = &pool->workers[(first + i) % count];
+        if (victim != worker && dequeSteal(&victim->deque, job)) {
+            worker->steals++;
+            return true;
+        }
+    }
+    return false;
+}
+//Runs tasks until the pool stops and nothing is left queued
+static void *workerMain(void *arg){
+    StealWorker *worker = (StealWorker *)arg;
+    StealPool *pool = worker->pool;
+    current_worker = worker;
+    for (;;) {
+        PoolJob job;
+        if (findTask(worker, &job)) {
+            __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+            job.task(job.arg, worker->index);
+            if (__atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_SEQ_CST) == 0) {
+                pthread_mutex_lock(&pool->lock);
+                pthread_cond_broadcast(&pool->idle);
+                pthread_mutex_unlock(&pool->lock);
+            }
+            continue;
+        }
+        //Something is queued but was not found (a steal lost a race, or it is being pushed): look again
+        if (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) > 0) {
+            sched_yield();
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+        bool done = pool->stopping && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (done) {
+            break;
+        }
+    }
+    current_worker = NULL;
+    return NULL;
+}
+//Starts threads workers (at most POOL_MAX_THREADS). Fails if not even one could be started
+bool StealPool_Start(StealPool *pool, int threads){
+    memset(pool, 0, sizeof(StealPool));
+    threads = threads < 1 ? 1 : (threads > POOL_MAX_THREADS ? POOL_MAX_THREADS : threads);
+    //Deques are cache line aligned, which malloc does not promise (and aligned_alloc is missing on Windows)
+    pool->memory = malloc(threads * sizeof(StealWorker) + STEAL_CACHE_LINE);
+    if (pool->memory == NULL) {
+        return false;
+    }
+    pool->workers = (StealWorker *)(((uintptr_t)pool->memory + STEAL_CACHE_LINE - 1) & ~(uintptr_t)(STEAL_CACHE_LINE - 1));
+    memset(pool->workers, 0, threads * sizeof(StealWorker));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready, NULL);
+    pthread_cond_init(&pool->space, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (int i = 0; i < threads; ++i) {
+        StealWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+    }
+    //Workers start stealing while the later ones are still being created; the deques of those are empty until then,
+    //and so are those of any that fail to start
+    __atomic_store_n(&pool->count, threads, __ATOMIC_RELEASE);
+    for (int i = 0; i < threads; ++i) {
+        if (pthread_create(&pool->workers[i].thread, NULL, workerMain, &pool->workers[i]) != 0) {
+            __atomic_store_n(&pool->count, i, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    if (pool->count == 0) {
+        StealPool_Stop(pool);
+        return false;
+    }
+    return true;
+}
+//Queues task(arg). From inside a task it goes to the running worker's deque, where it runs next unless another
+//worker steals it first, or at once if that deque is full. From outside the pool it goes to the inbox, waiting for
+//room if POOL_QUEUE_SIZE tasks are already there
+void StealPool_Submit(StealPool *pool, PoolTask task, void *arg){
+    PoolJob job = {.task = task, .arg = arg};
+    __atomic_add_fetch(&pool->outstanding, 1, __ATOMIC_SEQ_CST);
+    StealWorker *worker = current_worker;
+    if (worker != NULL && worker->pool == pool) {
+        if (dequePush(&worker->deque, job)) {
+            announce(pool);
+            return;
+        }
+        task(arg, worker->index);
+        __atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (pool->tail - pool->head == POOL_QUEUE_SIZE) {
+        pthread_cond_wait(&pool->space, &pool->lock);
+    }
+    pool->inbox[pool->tail % POOL_QUEUE_SIZE] = job;
+    __atomic_store_n(&pool->tail, pool->tail + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&pool->lock);
+    announce(pool);
+}
+//Blocks until every submitted task, and every task those submitted, has finished
+void StealPool_Wait(StealPool *pool){
+    pthread_mutex_lock(&pool->lock);
+    while (__atomic_load_n(&pool->outstanding, __ATOMIC_SEQ_CST) > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+//Tasks taken from another worker's deque so far, to see how much balancing the pool had to do
+uint64_t StealPool_Steals(const StealPool *pool){
+    uint64_t steals = 0;
+    for (int i = 0; i < pool->count; ++i) {
+        steals += __atomic_load_n(&pool->workers[i].steals, __ATOMIC_RELAXED);
+    }
+    return steals;
+}
+//Finishes the queued tasks, then joins the workers
+void StealPool_Stop(StealPool *pool){
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pool->count = 0;
+    free(pool->memory);
+    pool->memory = NULL;
+    pool->workers = NULL;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->ready);
+    pthread_cond_destroy(&pool->space);
+    pthread_cond_destroy(&pool->idle);
+}
@@ -0,0 +1,53 @@
+//Work-stealing thread pool: every worker runs tasks from its own deque, newest first, and idle workers steal the
+//oldest task from another worker's deque. Suits tasks that spawn more tasks and vary a lot in cost, where the
+//single shared queue of ThreadPool would be contended and badly balanced
+#ifndef TETRIS_STEAL_H
+#define TETRIS_STEAL_H
+
+#include <stdalign.h>
+#include "tetris_pool.h"
+
+//Macro Definitions
+#define STEAL_DEQUE_SIZE 1024U   // tasks one worker's deque holds, a power of two; a task spawned past that runs at once
+#define STEAL_CACHE_LINE 64
+
+//Chase-Lev deque: the owner pushes and takes at bottom, thieves take from top. Only top is ever contended
+typedef struct StealDeque {
+    alignas(STEAL_CACHE_LINE) int64_t top;
+    alignas(STEAL_CACHE_LINE) int64_t bottom;
+    PoolJob jobs[STEAL_DEQUE_SIZE];
+} StealDeque;
+typedef struct StealPool StealPool;
+//One worker thread, its deque and the index its tasks are told
+typedef struct StealWorker {
+    StealDeque deque;
+    pthread_t thread;
+    StealPool *pool;
+    uint64_t rng;                     // picks the first victim to steal from
+    uint64_t steals;                  // tasks this worker took from another one
+    int index;
+} StealWorker;
+struct StealPool {
+    StealWorker *workers;             // count of them, inside memory
+    void *memory;
+    int count;                        // worker threads running
+    uint32_t queued;                  // tasks in the inbox or a deque, updated atomically
+    uint32_t outstanding;             // tasks queued or running, updated atomically
+    uint32_t sleeping;                // workers waiting for a task, updated atomically
+    pthread_mutex_t lock;             // guards the inbox and the waits below
+    pthread_cond_t ready;             // signalled when a task is queued or the pool stops
+    pthread_cond_t space;             // signalled when a task leaves the inbox
+    pthread_cond_t idle;              // signalled when the last outstanding task finishes
+    PoolJob inbox[POOL_QUEUE_SIZE];   // tasks submitted from outside the pool
+    uint32_t head;                    // next inbox task to run
+    uint32_t tail;                    // where the next inbox task is queued
+    bool stopping;
+};
+
+bool StealPool_Start(StealPool *pool, int threads);
+void StealPool_Submit(StealPool *pool, PoolTask task, void *arg);
+void StealPool_Wait(StealPool *pool);
+uint64_t StealPool_Steals(const StealPool *pool);
+void StealPool_Stop(StealPool *pool);
+
+#endif
@@ -0,0 +1,84 @@
+//Score verifier: re-simulates submitted replays on a thread pool and accepts a claimed score only if the replay
+//really produces it. Reads one submission per line from stdin: <claimed score> <replay file> [player name]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tetris_pool.h"
+#include "tetris_replay.h"
+
+//Macro Definitions
+#define SUBMISSION_LINE_MAX 512
+
+//One claimed score waiting for its verdict
+typedef struct Submission {
+    uint32_t line;                   // line of stdin it came from, to match verdicts up with submissions
+    uint64_t claimed;
+    char path[SUBMISSION_LINE_MAX];
+    char name[50];
+} Submission;
+
+static uint64_t verdicts[REPLAY_SCORE_MISMATCH + 1];  // submissions by outcome, updated atomically by the workers
+
+//Seconds on a monotonic clock
+static double now(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+//Pool task: loads and re-simulates one submission, prints its verdict and frees it
+static void verifySubmission(void *arg, int worker){
+    const char *verdict_names[] = {"ACCEPT", "REJECT unreadable", "REJECT corrupt", "REJECT unfinished", "REJECT score"};
+    Submission *submission = (Submission *)arg;
+    Replay replay = {0};
+    TetrisState state = {0};
+    uint8_t verdict = REPLAY_UNREADABLE;
+    if (Replay_Load(&replay, submission->path)) {
+        verdict = Replay_Verify(replay.data, replay.size, submission->claimed, &state);
+    }
+    __atomic_fetch_add(&verdicts[verdict], 1, __ATOMIC_RELAXED);
+    //One printf per verdict, so lines from different workers never interleave
+    printf("%u %s %s claimed %lu actual %lu (%s)\n", submission->line, verdict_names[verdict], submission->name,
+           submission->claimed, state.score, submission->path);
+    Replay_Free(&replay);
+    free(submission);
+    (void)worker;
+}
+
+int main(int argc, char *argv[]){
+    int threads = argc >= 2 ? atoi(argv[1]) : ThreadPool_DefaultThreads();
+    ThreadPool pool;
+    if (!ThreadPool_Start(&pool, threads)) {
+        fprintf(stderr, "Could not start worker threads\n");
+        return 1;
+    }
+    double start = now();
+    char line[SUBMISSION_LINE_MAX];
+    uint32_t count = 0;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        Submission *submission = (Submission *)calloc(1, sizeof(Submission));
+        if (submission == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            break;
+        }
+        submission->line = ++count;
+        strcpy(submission->name, "-");
+        if (sscanf(line, "%lu %511s %49s", &submission->claimed, submission->path, submission->name) < 2) {
+            fprintf(stderr, "%u: expected <claimed score> <replay file> [player name]\n", count);
+            free(submission);
+            continue;
+        }
+        ThreadPool_Submit(&pool, verifySubmission, submission);
+    }
+    ThreadPool_Wait(&pool);
+    threads = pool.count;
+    ThreadPool_Stop(&pool);
+    double elapsed = now() - start;
+    uint64_t verified = 0;
+    for (int i = 0; i <= REPLAY_SCORE_MISMATCH; ++i) {
+        verified += verdicts[i];
+    }
+    fprintf(stderr, "%lu replays verified, %lu accepted, in %.3f s on %d threads (%.0f replays/s)\n", verified,
+            verdicts[REPLAY_VERIFIED], elapsed, threads, elapsed > 0 ? verified / elapsed : 0.0);
+    return verdicts[REPLAY_VERIFIED] == verified ? 0 : 2;
+}